@@ -0,0 +1,936 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "benchmark_tools.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread.hpp>
+#include "character_recognizer.h"
+#include "filter_statistics.h"
+#include "font_registry.h"
+#include "glyph_matching.h"
+#include "recognition_distance.h"
+#include "image_utils.h"
+#include "prefilter_context.h"
+#include "prefilter_entry.h"
+#include "prefilter_retinex.h"
+#include "recognition_helpers.h"
+#include "rng_builder.h"
+#include "segmentator.h"
+#include "segment.h"
+#include "segment_tools.h"
+#include "weak_segmentator.h"
+
+namespace benchmark_tools
+{
+	using namespace imago;
+
+	class Stopwatch
+	{
+	public:
+		Stopwatch() 
+		{
+			reset();
+		}
+
+		void reset()
+		{
+			start = boost::posix_time::microsec_clock::universal_time();
+		}
+
+		double elapsedMs() const
+		{
+			return (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1000.0;
+		}
+
+	private:
+		boost::posix_time::ptime start;
+	};
+
+	typedef int (*BenchmarkFunction)(Settings& vars, const strings& images);
+
+	struct BenchmarkEntry
+	{
+		const char* name;
+		const char* description;
+		BenchmarkFunction routine;
+	};
+
+	int benchmarkGlyphKernels(Settings& vars, const strings& images)
+	{
+		using namespace CharacterRecognizerImp;
+
+		const int glyphs_count = 64;
+		const int templates_count = 512;
+
+		srand(11);
+
+		std::vector<cv::Mat1b> glyphs(glyphs_count);
+		std::vector<GlyphMask> masks(glyphs_count);
+		for (int g = 0; g < glyphs_count; g++)
+		{
+			glyphs[g] = cv::Mat1b(REQUIRED_SIZE, REQUIRED_SIZE);
+			for (int y = 0; y < REQUIRED_SIZE; y++)
+				for (int x = 0; x < REQUIRED_SIZE; x++)
+					glyphs[g](y, x) = (rand() % 3 == 0) ? 0 : 255;
+			buildGlyphMask(glyphs[g], masks[g]);
+		}
+
+		Templates templates(templates_count);
+		for (int t = 0; t < templates_count; t++)
+			for (int u = 0; u < INTERNAL_ARRAY_SIZE; u++)
+			{
+				templates[t].penalty_ink[u] = CHARACTERS_OFFSET + rand() % 64;
+				templates[t].penalty_white[u] = CHARACTERS_OFFSET + rand() % 192;
+			}
+
+		const double comparisons = (double)glyphs_count * templates_count;
+		double checksum = 0.0;
+
+		Stopwatch timer;
+		for (int g = 0; g < glyphs_count; g++)
+			for (int t = 0; t < templates_count; t++)
+				checksum += compareImages(glyphs[g], templates[t].penalty_ink, templates[t].penalty_white);
+		double reference_ms = timer.elapsedMs();
+		printf("  %-10s %10.1f ns per comparison\n", "reference", reference_ms * 1e6 / comparisons);
+
+		for (int level = 0; level < glyph_matching::klCount; level++)
+		{
+			glyph_matching::MaskedSumsFunction kernel = glyph_matching::getMaskedSumsKernel(level);
+			if (kernel == NULL)
+			{
+				printf("  %-10s not supported\n", glyph_matching::getKernelLevelName(level));
+				continue;
+			}
+
+			double sum = 0.0;
+			timer.reset();
+			for (int g = 0; g < glyphs_count; g++)
+				for (int t = 0; t < templates_count; t++)
+					sum += compareImages(masks[g], templates[t].penalty_ink, templates[t].penalty_white, kernel);
+			double ms = timer.elapsedMs();
+
+			printf("  %-10s %10.1f ns per comparison, speedup %.1fx%s\n", glyph_matching::getKernelLevelName(level), 
+				ms * 1e6 / comparisons, ms > 0.0 ? reference_ms / ms : 0.0, sum == checksum ? "" : ", RESULTS DIFFER");
+		}
+
+		return 0;
+	}
+
+	int benchmarkTemplateSearch(Settings& vars, const strings& images)
+	{
+		using namespace CharacterRecognizerImp;
+
+		const int segments_count = 200;
+
+		srand(17);
+
+		Templates templates(700);
+		for (size_t u = 0; u < templates.size(); u++)
+		{
+			cv::Mat1b glyph(REQUIRED_SIZE, REQUIRED_SIZE);
+			for (int y = 0; y < REQUIRED_SIZE; y++)
+				for (int x = 0; x < REQUIRED_SIZE; x++)
+					glyph(y, x) = (rand() % 3 == 0) ? 0 : 255;
+			calculatePenalties(glyph, templates[u].penalty_ink, templates[u].penalty_white);
+			templates[u].setText(std::string(1, (char)('0' + rand() % 70)));
+			templates[u].wh_ratio = 0.2 + (rand() % 200) / 100.0;
+		}
+		TemplateIndex index(templates);
+
+		std::vector<cv::Mat1b> segments(segments_count);
+		for (int s = 0; s < segments_count; s++)
+		{
+			segments[s] = cv::Mat1b(10 + rand() % 30, 10 + rand() % 30);
+			for (int y = 0; y < segments[s].rows; y++)
+				for (int x = 0; x < segments[s].cols; x++)
+					segments[s](y, x) = (rand() % 3 == 0) ? 0 : 255;
+		}
+
+		// all templates are compared, ratio is checked afterwards
+		Stopwatch timer;
+		for (int s = 0; s < segments_count; s++)
+		{
+			double ratio;
+			cv::Mat1b img = prepareImage(vars, segments[s], ratio);
+			GlyphMask mask;
+			buildGlyphMask(img, mask);
+			RecognitionDistance rd;
+			for (size_t u = 0; u < templates.size(); u++)
+			{
+				double distance = compareImages(mask, templates[u].penalty_ink, templates[u].penalty_white);
+				if (imago::absolute(ratio - templates[u].wh_ratio) < vars.characters.RatioDiffThresh)
+				{
+					char c = templates[u].text[0];
+					rd.setMinimum(c, distance);
+				}
+			}
+		}
+		double full_ms = timer.elapsedMs();
+		printf("  %-14s %10.1f us per segment\n", "full scan", full_ms * 1000.0 / segments_count);
+
+		timer.reset();
+		for (int s = 0; s < segments_count; s++)
+			recognizeMat(vars, segments[s], index);
+		double indexed_ms = timer.elapsedMs();
+		printf("  %-14s %10.1f us per segment, speedup %.1fx\n", "indexed", indexed_ms * 1000.0 / segments_count,
+			indexed_ms > 0.0 ? full_ms / indexed_ms : 0.0);
+
+		std::vector<const cv::Mat1b*> batch;
+		for (int s = 0; s < segments_count; s++)
+			batch.push_back(&segments[s]);
+
+		for (int threads = 1; threads <= 4; threads *= 2)
+		{
+			std::vector<RecognitionDistance> results;
+			timer.reset();
+			recognizeBatch(vars, batch, index, results, threads);
+			double batch_ms = timer.elapsedMs();
+			printf("  batch, %d thr %10.1f us per segment, speedup %.1fx\n", threads, batch_ms * 1000.0 / segments_count,
+				batch_ms > 0.0 ? full_ms / batch_ms : 0.0);
+		}
+
+		return 0;
+	}
+
+	int benchmarkPenalties(Settings& vars, const strings& images)
+	{
+		using namespace CharacterRecognizerImp;
+
+		const int glyphs_count = 20;
+
+		srand(23);
+		std::vector<cv::Mat1b> glyphs(glyphs_count);
+		for (int g = 0; g < glyphs_count; g++)
+		{
+			glyphs[g] = cv::Mat1b(REQUIRED_SIZE, REQUIRED_SIZE);
+			for (int y = 0; y < REQUIRED_SIZE; y++)
+				for (int x = 0; x < REQUIRED_SIZE; x++)
+					glyphs[g](y, x) = (rand() % 4 == 0) ? 0 : 255;
+		}
+
+		MatchRecord mr;
+		Stopwatch timer;
+		for (int g = 0; g < glyphs_count; g++)
+			calculatePenaltiesReference(glyphs[g], mr.penalty_ink, mr.penalty_white);
+		double reference_ms = timer.elapsedMs();
+		printf("  %-10s %10.1f us per glyph\n", "reference", reference_ms * 1000.0 / glyphs_count);
+
+		timer.reset();
+		for (int g = 0; g < glyphs_count; g++)
+			calculatePenalties(glyphs[g], mr.penalty_ink, mr.penalty_white);
+		double edt_ms = timer.elapsedMs();
+		printf("  %-10s %10.1f us per glyph, speedup %.1fx\n", "edt", edt_ms * 1000.0 / glyphs_count,
+			edt_ms > 0.0 ? reference_ms / edt_ms : 0.0);
+
+		return 0;
+	}
+
+	int benchmarkPyramid(Settings& vars, const strings& images)
+	{
+		using namespace CharacterRecognizerImp;
+
+		if (images.empty())
+		{
+			printf("  no images specified, use -dir (e.g. -dir examples)\n");
+			return 1;
+		}
+
+		// connected components of symbol size are taken as glyphs
+		SegmentDeque segments;
+		for (size_t u = 0; u < images.size(); u++)
+		{
+			Image img;
+			try
+			{
+				ImageUtils::loadImageFromFile(img, "%s", images[u].c_str());
+			}
+			catch (ImagoException& e)
+			{
+				printf("  skipped %s: %s\n", images[u].c_str(), e.what());
+				continue;
+			}
+			cv::threshold(img, img, 128, 255, CV_THRESH_BINARY);
+
+			SegmentDeque found;
+			Segmentator::segmentate(img, found);
+			for (SegmentDeque::iterator it = found.begin(); it != found.end(); ++it)
+			{
+				if ((*it)->getHeight() >= 8 && (*it)->getHeight() <= 80 && (*it)->getWidth() <= 2 * (*it)->getHeight())
+					segments.push_back(*it);
+				else
+					delete *it;
+			}
+		}
+
+		std::vector<const cv::Mat1b*> batch;
+		for (SegmentDeque::iterator it = segments.begin(); it != segments.end(); ++it)
+			batch.push_back(*it);
+		printf("  %u glyphs from %u images\n", (unsigned int)batch.size(), (unsigned int)images.size());
+
+		if (!batch.empty())
+		{
+			boost::shared_ptr<const TemplateIndex> index = FontRegistry::getInstance().getIndex();
+			const int survivors_original = vars.characters.PyramidSurvivors;
+
+			vars.characters.PyramidSurvivors = 0;
+			std::vector<RecognitionDistance> reference;
+			Stopwatch timer;
+			recognizeBatch(vars, batch, *index, reference);
+			double reference_ms = timer.elapsedMs();
+			printf("  %-14s %10.1f us per glyph\n", "exact", reference_ms * 1000.0 / batch.size());
+
+			static const int Survivors[] = { 4, 8, 16, 32, 64 };
+			for (size_t s = 0; s < sizeof(Survivors) / sizeof(Survivors[0]); s++)
+			{
+				vars.characters.PyramidSurvivors = Survivors[s];
+				std::vector<RecognitionDistance> results;
+				timer.reset();
+				recognizeBatch(vars, batch, *index, results);
+				double ms = timer.elapsedMs();
+
+				int same = 0;
+				for (size_t u = 0; u < batch.size(); u++)
+					if (results[u].getBest() == reference[u].getBest())
+						same++;
+
+				printf("  %3d survivors %10.1f us per glyph, speedup %.1fx, best char kept %.1f%%\n", Survivors[s],
+					ms * 1000.0 / batch.size(), ms > 0.0 ? reference_ms / ms : 0.0, 100.0 * same / batch.size());
+			}
+
+			vars.characters.PyramidSurvivors = survivors_original;
+		}
+
+		for (SegmentDeque::iterator it = segments.begin(); it != segments.end(); ++it)
+			delete *it;
+
+		return 0;
+	}
+
+	bool sameSegments(const Segment& a, const Segment& b)
+	{
+		if (a.getX() != b.getX() || a.getY() != b.getY() || a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight())
+			return false;
+
+		for (int y = 0; y < a.getHeight(); y++)
+			if (memcmp(a.ptr(y), b.ptr(y), a.getWidth()) != 0)
+				return false;
+
+		return true;
+	}
+
+	int benchmarkSegmentator(Settings& vars, const strings& images)
+	{
+		const int page_size = 4000;
+
+		// the first -dir image scaled to page size, or a synthetic page of text-like blobs and lines
+		Image page;
+		if (!images.empty())
+		{
+			Image src;
+			ImageUtils::loadImageFromFile(src, "%s", images[0].c_str());
+			cv::resize(src, page, cv::Size(page_size, page_size), 0.0, 0.0, cv::INTER_NEAREST);
+			cv::threshold(page, page, 128, 255, CV_THRESH_BINARY);
+		}
+		else
+		{
+			srand(23);
+			page.init(page_size, page_size);
+			page.fillWhite();
+			for (int blob = 0; blob < 40000; blob++)
+			{
+				int x = rand() % (page_size - 16), y = rand() % (page_size - 16);
+				int w = 2 + rand() % 12, h = 2 + rand() % 14;
+				for (int dy = 0; dy < h; dy++)
+					for (int dx = 0; dx < w; dx++)
+						if (rand() % 3 != 0)
+							page.getByte(x + dx, y + dy) = 0;
+			}
+			for (int line = 0; line < 400; line++)
+			{
+				int x = rand() % page_size, y = rand() % page_size;
+				int length = 50 + rand() % 400;
+				bool horizontal = rand() % 2 == 0;
+				for (int t = 0; t < length; t++)
+				{
+					int px = horizontal ? x + t : x, py = horizontal ? y : y + t;
+					if (px < page_size && py < page_size)
+						page.getByte(px, py) = 0;
+				}
+			}
+		}
+
+		SegmentDeque reference, runs;
+
+		Stopwatch timer;
+		Segmentator::segmentateReference(page, reference);
+		double reference_ms = timer.elapsedMs();
+		printf("  %-10s %10.1f ms, %u segments\n", "reference", reference_ms, (unsigned int)reference.size());
+
+		timer.reset();
+		Segmentator::segmentate(page, runs);
+		double runs_ms = timer.elapsedMs();
+
+		bool same = reference.size() == runs.size();
+		for (size_t u = 0; same && u < runs.size(); u++)
+			same = sameSegments(*reference[u], *runs[u]);
+		printf("  %-10s %10.1f ms, %u segments, speedup %.1fx%s\n", "runs", runs_ms, (unsigned int)runs.size(),
+			runs_ms > 0.0 ? reference_ms / runs_ms : 0.0, same ? "" : ", RESULTS DIFFER");
+
+		for (size_t u = 0; u < reference.size(); u++)
+			delete reference[u];
+		for (size_t u = 0; u < runs.size(); u++)
+			delete runs[u];
+
+		return 0;
+	}
+
+	// pixel by pixel versions of the image primitives for comparison
+	void fillWhitePixelwise(Image& img)
+	{
+		for (int y = 0; y < img.getHeight(); y++)
+			for (int x = 0; x < img.getWidth(); x++)
+				img.getByte(x, y) = 255;
+	}
+
+	void invertColorPixelwise(Image& img)
+	{
+		for (int y = 0; y < img.getHeight(); y++)
+			for (int x = 0; x < img.getWidth(); x++)
+				img.getByte(x, y) = 255 - img.getByte(x, y);
+	}
+
+	double densityPixelwise(const Image& img)
+	{
+		int density = 0;
+		for (int y = 0; y < img.getHeight(); y++)
+			for (int x = 0; x < img.getWidth(); x++)
+				if (img.getByte(x, y) == 0)
+					density++;
+		return (double)density / (img.getWidth() * img.getHeight());
+	}
+
+	void getColorCountsPixelwise(const Image& img, int& black, int& white, int& other)
+	{
+		black = white = other = 0;
+		for (int y = 0; y < img.getHeight(); y++)
+			for (int x = 0; x < img.getWidth(); x++)
+				if (img.getByte(x, y) == 0)
+					black++;
+				else if (img.getByte(x, y) == 255)
+					white++;
+				else
+					other++;
+	}
+
+	void cropPixelwise(Image& img)
+	{
+		int w = img.getWidth(), h = img.getHeight();
+		int left, right, top, bottom;
+		for (left = 0; left < w; left++)
+			for (int y = 0; y < h; y++)
+				if (img.isFilled(left, y))
+					goto left_done;
+		left_done:
+		for (right = w - 1; right >= left; right--)
+			for (int y = 0; y < h; y++)
+				if (img.isFilled(right, y))
+					goto right_done;
+		right_done:
+		for (top = 0; top < h; top++)
+			for (int x = 0; x < w; x++)
+				if (img.isFilled(x, top))
+					goto top_done;
+		top_done:
+		for (bottom = h - 1; bottom >= top; bottom--)
+			for (int x = 0; x < w; x++)
+				if (img.isFilled(x, bottom))
+					goto bottom_done;
+		bottom_done:
+		img.crop(left, top, right, bottom);
+	}
+
+	void decornerPixelwise(Image& img)
+	{
+		for (int y = 0; y < img.getHeight(); y++)
+			for (int x = 0; x < img.getWidth(); x++)
+				if (img.isFilled(x, y) && SegmentTools::getInRange(img, Vec2i(x, y), 1).size() > 2)
+					img.getByte(x, y) = 255;
+	}
+
+	bool sameImages(const Image& a, const Image& b)
+	{
+		if (a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight())
+			return false;
+		for (int y = 0; y < a.getHeight(); y++)
+			if (memcmp(a.ptr(y), b.ptr(y), a.getWidth()) != 0)
+				return false;
+		return true;
+	}
+
+	void printPrimitiveTimes(const char* name, double pixelwise_ms, double fast_ms, bool same)
+	{
+		printf("  %-12s %10.2f ms %10.2f ms, speedup %.1fx%s\n", name, pixelwise_ms, fast_ms,
+			fast_ms > 0.0 ? pixelwise_ms / fast_ms : 0.0, same ? "" : ", RESULTS DIFFER");
+	}
+
+	int benchmarkImagePrimitives(Settings& vars, const strings& images)
+	{
+		// letter page scanned at 300 DPI
+		const int page_width = 2550, page_height = 3300;
+		const int repeats = 5;
+
+		// the first -dir image scaled to page size, or a synthetic page of antialiased text-like blobs within margins
+		Image page;
+		if (!images.empty())
+		{
+			Image src;
+			ImageUtils::loadImageFromFile(src, "%s", images[0].c_str());
+			cv::resize(src, page, cv::Size(page_width, page_height), 0.0, 0.0, cv::INTER_LINEAR);
+		}
+		else
+		{
+			srand(31);
+			page.init(page_width, page_height);
+			page.fillWhite();
+			for (int blob = 0; blob < 30000; blob++)
+			{
+				int x = 300 + rand() % (page_width - 640), y = 300 + rand() % (page_height - 640);
+				int w = 4 + rand() % 20, h = 4 + rand() % 24;
+				for (int dy = 0; dy < h; dy++)
+					for (int dx = 0; dx < w; dx++)
+					{
+						bool edge = dx == 0 || dy == 0 || dx == w - 1 || dy == h - 1;
+						page.getByte(x + dx, y + dy) = edge ? (byte)(64 + rand() % 128) : 0;
+					}
+			}
+		}
+
+		printf("  %-12s %13s %13s\n", "primitive", "pixelwise", "vectorized");
+
+		Image a, b;
+		double slow_ms = 0.0, fast_ms = 0.0;
+		Stopwatch timer;
+
+		for (int r = 0; r < repeats; r++)
+		{
+			a.copy(page);
+			b.copy(page);
+			timer.reset();
+			fillWhitePixelwise(a);
+			slow_ms += timer.elapsedMs();
+			timer.reset();
+			b.fillWhite();
+			fast_ms += timer.elapsedMs();
+		}
+		printPrimitiveTimes("fillWhite", slow_ms / repeats, fast_ms / repeats, sameImages(a, b));
+
+		slow_ms = fast_ms = 0.0;
+		for (int r = 0; r < repeats; r++)
+		{
+			a.copy(page);
+			b.copy(page);
+			timer.reset();
+			invertColorPixelwise(a);
+			slow_ms += timer.elapsedMs();
+			timer.reset();
+			b.invertColor();
+			fast_ms += timer.elapsedMs();
+		}
+		printPrimitiveTimes("invertColor", slow_ms / repeats, fast_ms / repeats, sameImages(a, b));
+
+		double slow_density = 0.0, fast_density = 0.0;
+		slow_ms = fast_ms = 0.0;
+		for (int r = 0; r < repeats; r++)
+		{
+			timer.reset();
+			slow_density = densityPixelwise(page);
+			slow_ms += timer.elapsedMs();
+			timer.reset();
+			fast_density = page.density();
+			fast_ms += timer.elapsedMs();
+		}
+		printPrimitiveTimes("density", slow_ms / repeats, fast_ms / repeats, slow_density == fast_density);
+
+		int slow_counts[3] = {0}, fast_counts[3] = {0};
+		slow_ms = fast_ms = 0.0;
+		for (int r = 0; r < repeats; r++)
+		{
+			timer.reset();
+			getColorCountsPixelwise(page, slow_counts[0], slow_counts[1], slow_counts[2]);
+			slow_ms += timer.elapsedMs();
+			timer.reset();
+			page.getColorCounts(fast_counts[0], fast_counts[1], fast_counts[2]);
+			fast_ms += timer.elapsedMs();
+		}
+		printPrimitiveTimes("colorCounts", slow_ms / repeats, fast_ms / repeats, memcmp(slow_counts, fast_counts, sizeof(slow_counts)) == 0);
+
+		slow_ms = fast_ms = 0.0;
+		for (int r = 0; r < repeats; r++)
+		{
+			a.copy(page);
+			b.copy(page);
+			timer.reset();
+			cropPixelwise(a);
+			slow_ms += timer.elapsedMs();
+			timer.reset();
+			b.crop();
+			fast_ms += timer.elapsedMs();
+		}
+		printPrimitiveTimes("crop", slow_ms / repeats, fast_ms / repeats, sameImages(a, b));
+
+		// decorner works on binarized images
+		Image binarized;
+		binarized.copy(page);
+		for (int y = 0; y < binarized.getHeight(); y++)
+			for (int x = 0; x < binarized.getWidth(); x++)
+				binarized.getByte(x, y) = binarized.getByte(x, y) < 128 ? 0 : 255;
+
+		slow_ms = fast_ms = 0.0;
+		for (int r = 0; r < repeats; r++)
+		{
+			a.copy(binarized);
+			b.copy(binarized);
+			timer.reset();
+			decornerPixelwise(a);
+			slow_ms += timer.elapsedMs();
+			timer.reset();
+			WeakSegmentator::decorner(b, 255);
+			fast_ms += timer.elapsedMs();
+		}
+		printPrimitiveTimes("decorner", slow_ms / repeats, fast_ms / repeats, sameImages(a, b));
+
+		return 0;
+	}
+
+	int benchmarkRetinex(Settings& vars, const strings& images)
+	{
+		// the first -dir image, or a synthetic unevenly lit page
+		Image page;
+		if (!images.empty())
+		{
+			ImageUtils::loadImageFromFile(page, "%s", images[0].c_str());
+		}
+		else
+		{
+			srand(37);
+			page.init(1600, 1200);
+			for (int y = 0; y < page.getHeight(); y++)
+				for (int x = 0; x < page.getWidth(); x++)
+				{
+					int value = 90 + x / 16 + y / 24 + rand() % 12;
+					if (x % 41 < 3 || (y % 57 < 3 && (x / 200) % 2 == 0))
+						value -= 70;
+					page.getByte(x, y) = (byte)std::min(std::max(value, 0), 255);
+				}
+		}
+
+		double megapixels = page.getWidth() * (double)page.getHeight() / 1e6;
+		printf("  image %ix%i, %.2f megapixels, %i workers\n", page.getWidth(), page.getHeight(), megapixels, vars.general.WorkerThreads);
+
+		Image reference, fast;
+		reference.copy(page);
+		fast.copy(page);
+
+		Stopwatch timer;
+		prefilter_retinex::retinexEnhanceReference(vars, reference);
+		double reference_ms = timer.elapsedMs();
+
+		timer.reset();
+		prefilter_retinex::retinexEnhance(vars, fast);
+		double fast_ms = timer.elapsedMs();
+
+		int max_diff = 0, differ = 0;
+		for (int y = 0; y < fast.getHeight(); y++)
+			for (int x = 0; x < fast.getWidth(); x++)
+			{
+				int diff = std::abs((int)fast.getByte(x, y) - (int)reference.getByte(x, y));
+				max_diff = std::max(max_diff, diff);
+				if (diff > 1)
+					differ++;
+			}
+
+		printf("  %-10s %10.1f ms, %8.1f ms/MP\n", "reference", reference_ms, reference_ms / megapixels);
+		printf("  %-10s %10.1f ms, %8.1f ms/MP, speedup %.1fx\n", "float32", fast_ms, fast_ms / megapixels,
+			fast_ms > 0.0 ? reference_ms / fast_ms : 0.0);
+		printf("  max difference %i, %.3f%% pixels differ by more than 1\n", max_diff, 
+			100.0 * differ / std::max(1, fast.getWidth() * fast.getHeight()));
+
+		return 0;
+	}
+
+	int benchmarkDecode(Settings& vars, const strings& images)
+	{
+		// -dir images, or a synthetic oversized 600 DPI scan saved as JPEG
+		strings files = images;
+		const char* synthetic = "imago_decode_benchmark.jpg";
+		if (files.empty())
+		{
+			srand(41);
+			Image page;
+			page.init(5400, 7600);
+			page.fillWhite();
+			for (int y = 0; y < page.getHeight(); y++)
+				for (int x = 0; x < page.getWidth(); x++)
+					if ((x / 12) % 9 == 0 || ((y / 40) % 5 == 0 && rand() % 4 == 0))
+						page.getByte(x, y) = (byte)(rand() % 60);
+			ImageUtils::saveImageToFile(page, "%s", synthetic);
+			files.push_back(synthetic);
+		}
+
+		printf("  reduced decode keeps the longer side not below %i\n", vars.csr.ReducedDecodeDimensions);
+
+		for (size_t u = 0; u < files.size(); u++)
+		{
+			Image full, reduced;
+
+			Stopwatch timer;
+			ImageUtils::loadImageFromFile(full, "%s", files[u].c_str());
+			double full_ms = timer.elapsedMs();
+
+			timer.reset();
+			ImageUtils::loadImageFromFileReduced(reduced, vars.csr.ReducedDecodeDimensions, "%s", files[u].c_str());
+			double reduced_ms = timer.elapsedMs();
+
+			printf("  %s: full %ix%i %.1f ms, reduced %ix%i %.1f ms\n", files[u].c_str(), 
+				full.getWidth(), full.getHeight(), full_ms, reduced.getWidth(), reduced.getHeight(), reduced_ms);
+		}
+
+		if (images.empty())
+			remove(synthetic);
+
+		return 0;
+	}
+
+	int benchmarkPrefilterContext(Settings& vars, const strings& images)
+	{
+		// the first -dir image, or a synthetic unevenly lit 300 DPI page
+		Image page;
+		if (!images.empty())
+		{
+			ImageUtils::loadImageFromFile(page, "%s", images[0].c_str());
+		}
+		else
+		{
+			srand(43);
+			page.init(2480, 3508);
+			for (int y = 0; y < page.getHeight(); y++)
+				for (int x = 0; x < page.getWidth(); x++)
+				{
+					int value = 110 + x / 40 + y / 60 + rand() % 12;
+					if ((x % 53 < 4 && (y / 300) % 2 == 0) || (y % 71 < 4 && (x / 250) % 2 == 1))
+						value -= 90;
+					page.getByte(x, y) = (byte)std::min(std::max(value, 0), 255);
+				}
+		}
+
+		printf("  image %ix%i\n", page.getWidth(), page.getHeight());
+
+		PrefilterContext context(page);
+		for (int run = 0; run < 3; run++)
+		{
+			// every filter of the chain with the same settings, as retries do
+			Settings chain = vars;
+			Image output;
+
+			Stopwatch timer;
+			int filters = 0;
+			for (bool applied = prefilterEntrypoint(chain, output, context); applied; 
+				 applied = applyNextPrefilter(chain, output, context))
+				filters++;
+			double ms = timer.elapsedMs();
+
+			printf("  run %i: %i filter(s) %10.1f ms, images built %i, reused %i, %u bytes\n", run + 1, filters, ms, 
+				context.getBuiltCount(), context.getHitCount(), (unsigned int)context.getMemoryUsage());
+		}
+
+		return 0;
+	}
+
+	int benchmarkFilterOrder(Settings& vars, const strings& images)
+	{
+		if (images.empty())
+		{
+			printf("  images are required, use -dir\n");
+			return 1;
+		}
+
+		// statistics of this run only, the first round keeps the fixed order
+		FilterStatistics statistics;
+		for (int round = 0; round <= 3; round++)
+		{
+			Settings round_vars = vars;
+			round_vars.general.AdaptiveFilters = round > 0;
+			round_vars.caches.PFilterStatistics = &statistics;
+
+			double total_ms = 0.0;
+			int warnings = 0, failures = 0;
+			for (size_t u = 0; u < images.size(); u++)
+			{
+				Image img;
+				ImageUtils::loadImageFromFile(img, "%s", images[u].c_str());
+
+				Stopwatch timer;
+				recognition_helpers::RecognitionResult result = recognition_helpers::recognizeImage(false, round_vars, img, "");
+				total_ms += timer.elapsedMs();
+
+				if (result.molecule.empty())
+					failures++;
+				else
+					warnings += result.warnings;
+			}
+
+			printf("  %-9s %10.1f ms per image, %i warnings, %i failures\n", round == 0 ? "fixed" : "adaptive", 
+				total_ms / images.size(), warnings, failures);
+		}
+
+		return 0;
+	}
+
+	int benchmarkRNG(Settings& vars, const strings& images)
+	{
+		srand(29);
+		for (int n = 10; n <= 10000; n *= 10)
+		{
+			// character centers on text lines with random points in between
+			Points2d points(n);
+			for (int u = 0; u < n; u++)
+			{
+				if (u % 2 == 0)
+					points[u] = Vec2d((u / 2) % 100 * 12 + 6, (u / 2) / 100 * 30 + 15);
+				else
+					points[u] = Vec2d(rand() % 1200, rand() % 3000);
+			}
+
+			std::vector<IntPair> edges, reference;
+
+			Stopwatch timer;
+			RNGBuilder::buildEdges(points, edges);
+			double fast_ms = timer.elapsedMs();
+
+			// the n^2 distance table of the reference does not fit for the largest sets
+			if (n <= 1000)
+			{
+				timer.reset();
+				RNGBuilder::buildEdgesReference(points, reference);
+				double reference_ms = timer.elapsedMs();
+				printf("  %6d points: %10.2f ms, reference %10.2f ms, %u edges%s\n", n, fast_ms, reference_ms,
+					(unsigned int)edges.size(), edges == reference ? "" : ", RESULTS DIFFER");
+			}
+			else
+			{
+				printf("  %6d points: %10.2f ms, %u edges\n", n, fast_ms, (unsigned int)edges.size());
+			}
+		}
+
+		return 0;
+	}
+
+	struct RegistryWorker
+	{
+		const std::vector<cv::Mat1b>* segments;
+		const Settings* vars;
+
+		void operator()()
+		{
+			using namespace CharacterRecognizerImp;
+			for (size_t s = 0; s < segments->size(); s++)
+			{
+				boost::shared_ptr<const TemplateIndex> index = FontRegistry::getInstance().getIndex();
+				recognizeMat(*vars, (*segments)[s], *index);
+			}
+		}
+	};
+
+	int benchmarkFontRegistry(Settings& vars, const strings& images)
+	{
+		using namespace CharacterRecognizerImp;
+
+		Stopwatch timer;
+		FontRegistry& registry = FontRegistry::getInstance();
+		boost::shared_ptr<const TemplateIndex> index = registry.getIndex();
+		double startup_ms = timer.elapsedMs();
+
+		printf("  startup: %.3f ms, %u font(s), %u templates\n", startup_ms, 
+			(unsigned int)registry.getFontsCount(), (unsigned int)registry.getTemplatesCount());
+		printf("  memory: %u bytes of templates used in place, %u bytes on heap\n",
+			(unsigned int)(registry.getTemplatesCount() * sizeof(MatchRecord)), (unsigned int)registry.getHeapUsage());
+
+		srand(19);
+		std::vector<cv::Mat1b> segments(100);
+		for (size_t s = 0; s < segments.size(); s++)
+		{
+			segments[s] = cv::Mat1b(10 + rand() % 30, 10 + rand() % 30);
+			for (int y = 0; y < segments[s].rows; y++)
+				for (int x = 0; x < segments[s].cols; x++)
+					segments[s](y, x) = (rand() % 3 == 0) ? 0 : 255;
+		}
+
+		for (int threads = 1; threads <= 4; threads *= 2)
+		{
+			RegistryWorker worker;
+			worker.segments = &segments;
+			worker.vars = &vars;
+
+			timer.reset();
+			boost::thread_group group;
+			for (int t = 0; t < threads; t++)
+				group.create_thread(worker);
+			group.join_all();
+			double ms = timer.elapsedMs();
+
+			printf("  %d thread(s) sharing templates: %.1f us per segment\n", threads, 
+				ms * 1000.0 / (segments.size() * threads));
+		}
+
+		return 0;
+	}
+
+	static const BenchmarkEntry Benchmarks[] = 
+	{
+		{ "glyph_kernels", "template matching kernels against the reference implementation", benchmarkGlyphKernels },
+		{ "penalties", "distance transform penalties against the reference search", benchmarkPenalties },
+		{ "template_search", "ratio indexed bounded template search against the full scan", benchmarkTemplateSearch },
+		{ "pyramid", "coarse-to-fine template matching latency and accuracy on -dir images", benchmarkPyramid },
+		{ "segmentator", "run-length connected components against the flood fill on a 4000x4000 page", benchmarkSegmentator },
+		{ "image_primitives", "row pointer and vectorized image primitives against pixel access on a 300 DPI page", benchmarkImagePrimitives },
+		{ "retinex", "single transform float32 retinex against the per-scale reference, time per megapixel", benchmarkRetinex },
+		{ "decode", "reduced resolution grayscale JPEG decoding against the full color decode", benchmarkDecode },
+		{ "prefilter_context", "prefilters chain and its retries sharing the derived images of the source", benchmarkPrefilterContext },
+		{ "filter_order", "recognition of -dir images with the fixed prefilters order, then learning the order", benchmarkFilterOrder },
+		{ "rng", "relative neighborhood graph from Delaunay triangulation for 10 to 10000 points", benchmarkRNG },
+		{ "font_registry", "shared templates startup, memory and concurrent use", benchmarkFontRegistry },
+	};
+
+	int performBenchmark(Settings& vars, const std::string& name, const strings& images)
+	{
+		for (size_t u = 0; u < sizeof(Benchmarks) / sizeof(Benchmarks[0]); u++)
+		{
+			if (name == Benchmarks[u].name)
+			{
+				printf("Benchmark '%s': %s\n", Benchmarks[u].name, Benchmarks[u].description);
+				return Benchmarks[u].routine(vars, images);
+			}
+		}
+
+		printf("Unknown benchmark '%s', available are:\n", name.c_str());
+		for (size_t u = 0; u < sizeof(Benchmarks) / sizeof(Benchmarks[0]); u++)
+			printf("  %s: %s\n", Benchmarks[u].name, Benchmarks[u].description);
+		return 1;
+	}
+}
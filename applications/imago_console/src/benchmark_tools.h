@@ -0,0 +1,30 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+
+#ifndef _benchmark_tools_h
+#define _benchmark_tools_h
+
+#include <string>
+#include "file_helpers.h"
+#include "settings.h"
+
+namespace benchmark_tools
+{
+	// runs specified benchmark (prints the list if name is unknown), images are used by some of them
+	int performBenchmark(imago::Settings& vars, const std::string& name, const strings& images);
+}
+
+#endif // _benchmark_tools_h
@@ -17,7 +17,26 @@
 #include "machine_learning.h"
 #include "similarity_tools.h"
 #include "settings.h"
+#include "filter_statistics.h"
+#include "exception.h"
 #include "log_ext.h"
+#include "self_tests.h"
+#include "benchmark_tools.h"
+
+static void saveFilterStatistics(const imago::Settings& vars, const std::string& filename)
+{
+	if (filename.empty() || vars.caches.PFilterStatistics->isFrozen())
+		return;
+
+	try
+	{
+		vars.caches.PFilterStatistics->save(filename);
+	}
+	catch (imago::ImagoException &e)
+	{
+		printf("%s\n", e.what());
+	}
+}
 
 int main(int argc, char **argv)
 {
@@ -35,6 +54,9 @@ int main(int argc, char **argv)
 		printf("  -compare molfile1 molfile2: calculate similarity between molfiles \n");
 		printf("    -retcode: returns similarity 0..100 in ERRORLEVEL \n");
 		printf("  -test dir_name: calculate similarity score on specified test collection\n");
+		printf("  -makefont templates_dir output_file: build font file from template images (C++ include for .inc output) \n");
+		printf("  -selftest: run internal consistency self-tests \n");
+		printf("  -benchmark name: run specified performance benchmark (images are taken from -dir if required) \n");
 		printf("\n OPTION SWITCHES: \n");
 		printf("  -config cfg_file: use specified configuration cluster file \n");		
 		printf("  -log: enables debug log output to ./log.html \n");
@@ -42,6 +64,10 @@ int main(int argc, char **argv)
 		printf("  -noexp: do not expand chemical abbreviations \n");		
 		printf("  -pr: use probablistic separator (experimental) \n");
 		printf("  -tl time_in_ms: timelimit per single image process (default is %u) \n", vars.general.TimeLimit);
+		printf("  -threads count: worker threads for batch routines, 0 means hardware concurrency (default is %i) \n", vars.general.WorkerThreads);
+		printf("  -speculative: recognize images of all prefilters concurrently on -threads workers, same result as one by one \n");
+		printf("  -filterstats stats_file: order prefilters by their outcomes for similar images, kept in stats_file \n");
+		printf("    -freezestats: use stats_file as is, for reproducible runs \n");
 		printf("  -similarity tool [-sparam additional_parameters]: override the default comparison method \n");
 		printf("  -pass: don't process images, only print their filenames \n");
 		printf("  -override config_string: override config by applying specified string \n");
@@ -63,15 +89,23 @@ int main(int argc, char **argv)
 	std::string molfile2 = "";
 	std::string override_cfg = "";
 	std::string output = "molecule.mol";
+	std::string benchmark = "";
+	std::string font_dir = "";
+	std::string font_output = "";
+	std::string filter_stats = "";
 
 	bool next_arg_dir = false;
 	bool next_arg_config = false;
 	bool next_arg_sim_tool = false;
 	bool next_arg_sim_param = false;
 	bool next_arg_tl = false;	
+	bool next_arg_threads = false;
 	bool next_arg_override_cfg = false;
 	bool next_arg_output = false;
+	bool next_arg_benchmark = false;
+	bool next_arg_filter_stats = false;
 	int next_arg_compare = 0; // two args
+	int next_arg_makefont = 0; // two args
 
 	bool mode_recursive = false;
 	bool mode_pass = false;
@@ -80,6 +114,8 @@ int main(int argc, char **argv)
 	bool mode_retcode = false;
 	bool mode_test_filter_only = false;
 	bool mode_test_similarity = false;
+	bool mode_selftest = false;
+	bool mode_freeze_stats = false;
 
 	for (int c = 1; c < argc; c++)
 	{
@@ -100,12 +136,24 @@ int main(int argc, char **argv)
 		else if (param == "-pr" || param == "-probablistic")
 			vars.general.UseProbablistics = true;
 
+		else if (param == "-speculative")
+			vars.general.SpeculativeFilters = true;
+
+		else if (param == "-filterstats")
+			next_arg_filter_stats = true;
+
+		else if (param == "-freezestats")
+			mode_freeze_stats = true;
+
 		else if (param == "-dir")
 			next_arg_dir = true;
 
 		else if (param == "-tl")
 			next_arg_tl = true;
 
+		else if (param == "-threads")
+			next_arg_threads = true;
+
 		else if (param == "-similarity")
 			next_arg_sim_tool = true;
 
@@ -142,6 +190,15 @@ int main(int argc, char **argv)
 			next_arg_dir = true;
 		}
 
+		else if (param == "-makefont")
+			next_arg_makefont = 2; // expected two params
+
+		else if (param == "-selftest")
+			mode_selftest = true;
+
+		else if (param == "-benchmark")
+			next_arg_benchmark = true;
+
 		else if (param == "-override")
 			next_arg_override_cfg = true;
 
@@ -176,11 +233,29 @@ int main(int argc, char **argv)
 				}
 				next_arg_compare--;
 			}			
+			else if (next_arg_makefont)
+			{
+				if (next_arg_makefont == 2)
+					font_dir = param;
+				else
+					font_output = param;
+				next_arg_makefont--;
+			}
 			else if (next_arg_output)
 			{
 				output = param;
 				next_arg_output = false;
 			}
+			else if (next_arg_benchmark)
+			{
+				benchmark = param;
+				next_arg_benchmark = false;
+			}
+			else if (next_arg_filter_stats)
+			{
+				filter_stats = param;
+				next_arg_filter_stats = false;
+			}
 			else if (next_arg_config)
 			{
 				config = param;
@@ -206,6 +281,11 @@ int main(int argc, char **argv)
 				vars.general.TimeLimit = atoi(param.c_str());
 				next_arg_tl = false;
 			}
+			else if (next_arg_threads)
+			{
+				vars.general.WorkerThreads = atoi(param.c_str());
+				next_arg_threads = false;
+			}
 			else if (next_arg_override_cfg)
 			{
 				if (!override_cfg.empty())
@@ -243,7 +323,45 @@ int main(int argc, char **argv)
 	if (!override_cfg.empty())
 		vars.fillFromDataStream(override_cfg);	
 
-	if (mode_test_filter_only)
+	if (!filter_stats.empty())
+	{
+		try
+		{
+			vars.general.AdaptiveFilters = true;
+			if (!vars.caches.PFilterStatistics->load(filter_stats))
+				printf("Filter statistics file '%s' not found, starting from the fixed order\n", filter_stats.c_str());
+			vars.caches.PFilterStatistics->setFrozen(mode_freeze_stats);
+		}
+		catch (imago::ImagoException &e)
+		{
+			printf("%s\n", e.what());
+			return 1;
+		}
+	}
+
+	if (mode_selftest)
+	{
+		return self_tests::performSelfTests();
+	}
+	else if (!benchmark.empty())
+	{
+		strings files;
+		if (!dir.empty())
+		{
+			if (file_helpers::getDirectoryContent(dir, files, mode_recursive) != 0)
+			{
+				printf("[ERROR] Can't get the content of directory '%s'\n", dir.c_str());
+				return 2;
+			}
+			file_helpers::filterOnlyImages(files);
+		}
+		return benchmark_tools::performBenchmark(vars, benchmark, files);
+	}
+	else if (!font_dir.empty() && !font_output.empty())
+	{
+		return recognition_helpers::performFontGeneration(vars, font_dir, font_output);
+	}
+	else if (mode_test_filter_only)
 	{
 		return recognition_helpers::performFilterTest(vars, image);
 	}
@@ -306,12 +424,15 @@ int main(int argc, char **argv)
 					recognition_helpers::performFileAction(true, vars, files[u], config, output_file);	
 				}
 			}
+			saveFilterStatistics(vars, filter_stats);
 		}
 	}
 	else if (!image.empty())
 	{
 		// single item mode
-		return recognition_helpers::performFileAction(true, vars, image, config, output);	
+		int result = recognition_helpers::performFileAction(true, vars, image, config, output);	
+		saveFilterStatistics(vars, filter_stats);
+		return result;
 	}		
 	
 	return 1; // "nothing to do" error
@@ -17,11 +17,19 @@
 #include "chemical_structure_recognizer.h"
 #include "molecule.h"
 #include "prefilter_entry.h"
+#include "filters_list.h"
+#include "filter_statistics.h"
+#include "platform_tools.h"
 #include "superatom_expansion.h"
 #include "log_ext.h"
 #include "image_utils.h"
+#include "character_recognizer.h"
+#include "font_storage.h"
 #include "indigo.h"
 #include "indigo-renderer.h"
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/shared_ptr.hpp>
 
 // Required for indigo-renderer:
 #ifdef _WIN32
@@ -66,64 +74,308 @@ namespace recognition_helpers
 	}
 
 
-	RecognitionResult recognizeImage(bool verbose, imago::Settings& vars, const imago::Image& src, const std::string& config)
+	// filtered image with the settings its recognition starts from
+	struct FilterCandidate
 	{
-		std::vector<RecognitionResult> results;
-		
-		imago::ChemicalStructureRecognizer _csr;
-		imago::Molecule mol;
+		imago::Settings vars; // vars.dynamic holds the recognition estimations after recognizeCandidate
+		imago::Image image;
+		std::string filter;
+		std::string image_class; // for the filter statistics, empty if they are not used
+	};
+
+	// the candidate of the filter just applied to the chain
+	static void fillCandidate(bool verbose, imago::Settings& chain, imago::PrefilterContext& prefilter, const std::string& config, 
+		                      FilterCandidate& candidate)
+	{
+		// the next filters see the configuration as before
+		applyConfig(verbose, chain, config);
+		candidate.vars = chain;
+		candidate.filter = imago::getAppliedFilterName(chain, prefilter);
+		if (chain.general.AdaptiveFilters && chain.caches.PFilterStatistics != NULL)
+			candidate.image_class = prefilter.getImageClass();
+	}
+
+	// applies the first or the next filter of the chain, returns false when there are no more filters
+	static bool applyFilter(bool verbose, imago::Settings& chain, imago::PrefilterContext& prefilter, const std::string& config, 
+		                    bool first, FilterCandidate& candidate)
+	{
+		bool applied = first ? imago::prefilterEntrypoint(chain, candidate.image, prefilter) : 
+		                       imago::applyNextPrefilter(chain, candidate.image, prefilter);
+		if (applied)
+			fillCandidate(verbose, chain, prefilter, config, candidate);
+		return applied;
+	}
+
+	// the outcome goes to the statistics ordering the filters, cancelled recognitions tell nothing
+	static void recordOutcome(const FilterCandidate& candidate, bool good, unsigned int start)
+	{
+		const imago::Settings& vars = candidate.vars;
+		if (candidate.image_class.empty() || vars.caches.PFilterStatistics == NULL ||
+			(vars.general.CancelRequested && *vars.general.CancelRequested))
+			return;
+
+		vars.caches.PFilterStatistics->recordRecognition(candidate.image_class, candidate.filter, good, platform::TICKS() - start);
+	}
+
+	// recognizes filtered image using a copy of its settings, returns false on failure;
+	// the estimations made are kept in candidate.vars.dynamic for the next filter
+	static bool recognizeCandidate(bool verbose, FilterCandidate& candidate, RecognitionResult& result, bool& good)
+	{
+		imago::Settings vars = candidate.vars;
+		vars.general.StartTime = 0;
+		unsigned int start = platform::TICKS();
+
+		try
+		{
+			imago::ChemicalStructureRecognizer _csr;
+			imago::Molecule mol;
+			_csr.image2mol(vars, candidate.image, mol);
+			candidate.vars.dynamic = vars.dynamic;
+
+			result.molecule = imago::expandSuperatoms(vars, mol);
+			result.warnings = mol.getWarningsCount() + mol.getDissolvingsCount() / vars.main.DissolvingsFactor;
+				
+			if (vars.dynamic.CapitalHeight < vars.main.MinGoodCharactersSize &&
+				!vars.general.ImageAlreadyBinarized)
+			{
+				result.warnings += vars.main.WarningsForTooSmallCharacters;
+			}
 
-		for (int iter = 0; ; iter++)
+			good = result.warnings <= vars.main.WarningsRecalcTreshold;				
+			
+			if (verbose)
+				printf("Filter [%u] done, warnings: %u, good: %u.\n", vars.general.FilterIndex, result.warnings, good);
+			recordOutcome(candidate, good, start);
+			return true;
+		}
+		catch (std::exception &e)
 		{
-			bool good = false;
+			candidate.vars.dynamic = vars.dynamic;
+			if (verbose)
+				printf("Filter [%u] exception '%s'.\n", vars.general.FilterIndex, e.what());
+			recordOutcome(candidate, false, start);
+			return false;
+		}
+	}
 
-			vars.general.StartTime = 0;
+	// recognizes the candidates concurrently, filters are applied in order when a worker is free and
+	// the remaining ones are cancelled as soon as the sequential order decides the result. A filter
+	// reading the recognition estimations waits for the preceding recognitions and gets their values,
+	// so every filter gets the image of the sequential path and the result is picked in its order
+	class SpeculativeRecognition
+	{
+	public:
+		SpeculativeRecognition(bool verbose, imago::Settings& chain, imago::PrefilterContext& prefilter, const std::string& config) 
+			: _verbose(verbose), _chain(chain), _prefilter(prefilter), _config(config), 
+			  _attempts(0), _exhausted(false), _filtering(false), _cancelled(false)
+		{
+		}
 
-			try
+		void run(int threads)
+		{
+			if (threads > (int)imago::getFiltersList().size())
+				threads = (int)imago::getFiltersList().size();
+
+			if (threads <= 1)
+			{
+				(*this)();
+			}
+			else
 			{
-				imago::Image img;
+				boost::thread_group group;
+				for (int t = 0; t < threads; t++)
+					group.create_thread(boost::ref(*this));
+				group.join_all();
+			}
+		}
 
-				if (iter == 0)
-				{
-					if (!imago::prefilterEntrypoint(vars, img, src))
-						break;
-				}
-				else
+		// results the sequential path gets: up to the first good one, or all of them
+		void getResults(std::vector<RecognitionResult>& results) const
+		{
+			for (size_t u = 0; u < _outcomes.size() && _outcomes[u].done; u++)
+			{
+				if (_outcomes[u].recognized)
+					results.push_back(_outcomes[u].result);
+				if (_outcomes[u].good)
+					break;
+			}
+		}
+
+		void operator()()
+		{
+			for (;;)
+			{
+				size_t u;
 				{
-					if (!imago::applyNextPrefilter(vars, img, src))
-						break;
+					boost::mutex::scoped_lock lock(_lock);
+					if (!takeCandidate(lock, u))
+						return;
 				}
 
-				applyConfig(verbose, vars, config);
-				_csr.image2mol(vars, img, mol);
+				Outcome outcome;
+				outcome.recognized = recognizeCandidate(_verbose, *_candidates[u], outcome.result, outcome.good);
+				outcome.done = true;
 
-				RecognitionResult result;
-				result.molecule = imago::expandSuperatoms(vars, mol);
-				result.warnings = mol.getWarningsCount() + mol.getDissolvingsCount() / vars.main.DissolvingsFactor;
-				
-				if (vars.dynamic.CapitalHeight < vars.main.MinGoodCharactersSize &&
-					!vars.general.ImageAlreadyBinarized)
+				boost::mutex::scoped_lock lock(_lock);
+				_outcomes[u] = outcome;
+				if (isDecided())
+					_cancelled = true;
+				_changed.notify_all();
+			}
+		}
+
+	private:
+		struct Outcome
+		{
+			bool done, recognized, good;
+			RecognitionResult result;
+			Outcome() : done(false), recognized(false), good(false) {}
+		};
+
+		// applies the next filter of the chain, returns false when there is nothing more to recognize
+		bool takeCandidate(boost::mutex::scoped_lock& lock, size_t& u)
+		{
+			// the chain and the prefilter context are used by one worker at a time
+			while (_filtering && !_cancelled)
+				_changed.wait(lock);
+
+			_filtering = true;
+			bool applied = false;
+			boost::shared_ptr<FilterCandidate> candidate(new FilterCandidate());
+
+			while (!applied && !_cancelled && !_exhausted)
+			{
+				try
 				{
-					result.warnings += vars.main.WarningsForTooSmallCharacters;
+					if (_attempts++ == 0)
+					{
+						applied = imago::prefilterEntrypoint(_chain, candidate->image, _prefilter);
+					}
+					else
+					{
+						applied = imago::applyNextPrefilter(_chain, candidate->image, _prefilter, true, true);
+						if (!applied && imago::isWaitingForEstimations(_chain, _prefilter))
+						{
+							while (!_cancelled && !isDone())
+								_changed.wait(lock);
+							if (_cancelled)
+								break;
+
+							// the sequential path applies it after the last recognition
+							if (!_candidates.empty())
+								_chain.dynamic = _candidates.back()->vars.dynamic;
+							applied = imago::applyNextPrefilter(_chain, candidate->image, _prefilter, false);
+						}
+					}
+					_exhausted = !applied;
 				}
+				catch (std::exception &e)
+				{
+					if (_verbose)
+						printf("Filter [%u] exception '%s'.\n", _chain.general.FilterIndex, e.what());
+				}
+			}
 
-				results.push_back(result);
+			_filtering = false;
+			_changed.notify_all();
 
-				good = result.warnings <= vars.main.WarningsRecalcTreshold;				
-			
-				if (verbose)
-					printf("Filter [%u] done, warnings: %u, good: %u.\n", vars.general.FilterIndex, result.warnings, good);
+			if (!applied || _cancelled)
+				return false;
+
+			fillCandidate(_verbose, _chain, _prefilter, _config, *candidate);
+			candidate->vars.general.CancelRequested = &_cancelled;
+			candidate->vars.general.WorkerThreads = 1;
+
+			u = _candidates.size();
+			_candidates.push_back(candidate);
+			_outcomes.push_back(Outcome());
+			return true;
+		}
+
+		// all the candidates taken are recognized
+		bool isDone() const
+		{
+			for (size_t u = 0; u < _outcomes.size(); u++)
+				if (!_outcomes[u].done)
+					return false;
+			return true;
+		}
+
+		// the first good candidate is known and all the candidates before it are done,
+		// or all the filters are applied and recognized
+		bool isDecided() const
+		{
+			for (size_t u = 0; u < _outcomes.size(); u++)
+			{
+				if (!_outcomes[u].done)
+					return false;
+				if (_outcomes[u].good)
+					return true;
 			}
-			catch (std::exception &e)
+			return _exhausted;
+		}
+
+		bool _verbose;
+		imago::Settings& _chain;
+		imago::PrefilterContext& _prefilter;
+		const std::string& _config;
+		std::vector<boost::shared_ptr<FilterCandidate> > _candidates;
+		std::vector<Outcome> _outcomes;
+		int _attempts;
+		bool _exhausted, _filtering;
+		volatile bool _cancelled;
+		boost::mutex _lock;
+		boost::condition_variable _changed;
+	};
+
+	RecognitionResult recognizeImage(bool verbose, imago::Settings& vars, const imago::Image& src, const std::string& config)
+	{
+		std::vector<RecognitionResult> results;
+
+		// filters are applied in order on their own settings, only the estimations of each recognition
+		// are passed to the next filter
+		imago::Settings chain = vars;
+		// images derived from the source are shared by the filters
+		imago::PrefilterContext prefilter(src);
+
+		// log is not shared between threads
+		if (vars.general.SpeculativeFilters && !imago::getLogExt().loggingEnabled())
+		{
+			int threads = vars.general.WorkerThreads;
+			if (threads <= 0)
+				threads = std::max(1, (int)boost::thread::hardware_concurrency());
+
+			SpeculativeRecognition recognition(verbose, chain, prefilter, config);
+			recognition.run(threads);
+			recognition.getResults(results);
+		}
+		else
+		{
+			for (int iter = 0; ; iter++)
 			{
-				if (verbose)
-					printf("Filter [%u] exception '%s'.\n", vars.general.FilterIndex, e.what());
+				bool good = false;
 
-			}
+				try
+				{
+					FilterCandidate candidate;
+					if (!applyFilter(verbose, chain, prefilter, config, iter == 0, candidate))
+						break;
 
-			if (good)
-				break;
-		} // for
+					RecognitionResult result;
+					if (recognizeCandidate(verbose, candidate, result, good))
+						results.push_back(result);
+					chain.dynamic = candidate.vars.dynamic;
+				}
+				catch (std::exception &e)
+				{
+					if (verbose)
+						printf("Filter [%u] exception '%s'.\n", chain.general.FilterIndex, e.what());
+				}
+
+				if (good)
+					break;
+			} // for
+		}
 
 		RecognitionResult result;
 		result.warnings = 999; // just big number to override
@@ -145,7 +397,7 @@ namespace recognition_helpers
 		try
 		{
 			imago::Image image;
-			imago::ImageUtils::loadImageFromFile(image, imageName.c_str());
+			imago::ImageUtils::loadImageFromFileReduced(image, vars.csr.ReducedDecodeDimensions, "%s", imageName.c_str());
 			
 			imago::Image out;
 			if (!imago::prefilterEntrypoint(vars, out, image))
@@ -161,6 +413,36 @@ namespace recognition_helpers
 		return result;
 	}
 
+	int performFontGeneration(imago::Settings& vars, const std::string& templatesDir, const std::string& outputName)
+	{
+		using namespace imago::CharacterRecognizerImp;
+
+		int result = 0; // ok mark
+		try
+		{
+			Templates templates;
+			if (!initializeTemplates(vars, templatesDir, templates))
+			{
+				printf("No templates found in '%s'\n", templatesDir.c_str());
+				return 2;
+			}
+
+			const std::string ext = ".inc";
+			if (outputName.size() > ext.size() && outputName.substr(outputName.size() - ext.size()) == ext)
+				FontStorage::saveEmbeddedSource(outputName, templates);
+			else
+				FontStorage::saveFile(outputName, templates);
+
+			printf("Font (%u templates) is saved to '%s'\n", (unsigned int)templates.size(), outputName.c_str());
+		}
+		catch (std::exception &e)
+		{
+			puts(e.what());
+			result = 1;
+		}
+		return result;
+	}
+
 	int performFileAction(bool verbose, imago::Settings& vars, const std::string& imageName, const std::string& configName,
 						  const std::string& outputName)
 	{
@@ -191,7 +473,7 @@ namespace recognition_helpers
 				imago::getLogExt().SetVirtualFS(vfs);
 			}
 
-			imago::ImageUtils::loadImageFromFile(image, imageName.c_str());
+			imago::ImageUtils::loadImageFromFileReduced(image, vars.csr.ReducedDecodeDimensions, "%s", imageName.c_str());
 
 			if (vars.general.ExtractCharactersOnly)
 			{
@@ -38,6 +38,9 @@ namespace recognition_helpers
 
 	int performFilterTest(imago::Settings& vars, const std::string& imageName);
 
+	// builds binary font file (or embeddable C++ include if outputName ends with .inc) from template images
+	int performFontGeneration(imago::Settings& vars, const std::string& templatesDir, const std::string& outputName);
+
 	int performFileAction(bool verbose, imago::Settings& vars, const std::string& imageName, 
 		                  const std::string& configName, const std::string& outputName = "molecule.mol");
 
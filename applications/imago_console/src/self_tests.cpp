@@ -0,0 +1,980 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "self_tests.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include "character_recognizer.h"
+#include "font_storage.h"
+#include "glyph_matching.h"
+#include "recognition_distance.h"
+#include "settings.h"
+#include "symbol_cache.h"
+#include "segmentator.h"
+#include "segment.h"
+#include "segment_runs.h"
+#include "segment_tools.h"
+#include "segment_index.h"
+#include "rng_builder.h"
+#include "weak_segmentator.h"
+#include "prefilter_retinex.h"
+#include "prefilter_basic.h"
+#include "prefilter_context.h"
+#include "prefilter_entry.h"
+#include "filters_list.h"
+#include "filter_statistics.h"
+#include "image_utils.h"
+#include "exception.h"
+
+namespace self_tests
+{
+	using namespace imago;
+
+	typedef bool (*SelfTestFunction)();
+
+	struct SelfTestEntry
+	{
+		const char* name;
+		SelfTestFunction routine;
+	};
+
+	cv::Mat1b randomGlyph(int ink_percent)
+	{
+		cv::Mat1b result(CharacterRecognizerImp::REQUIRED_SIZE, CharacterRecognizerImp::REQUIRED_SIZE);
+		for (int y = 0; y < result.rows; y++)
+			for (int x = 0; x < result.cols; x++)
+				result(y, x) = (rand() % 100 < ink_percent) ? 0 : 255;
+		return result;
+	}
+
+	bool testGlyphKernels()
+	{
+		using namespace CharacterRecognizerImp;
+
+		srand(7);
+		int mismatches = 0;
+
+		for (int iter = 0; iter < 200; iter++)
+		{
+			cv::Mat1b img = randomGlyph(iter % 100);
+
+			MatchRecord mr;
+			if (iter % 2)
+			{
+				calculatePenalties(randomGlyph(rand() % 100), mr.penalty_ink, mr.penalty_white);
+			}
+			else
+			{
+				for (int u = 0; u < INTERNAL_ARRAY_SIZE; u++)
+				{
+					mr.penalty_ink[u] = CHARACTERS_OFFSET + rand() % (256 - CHARACTERS_OFFSET);
+					mr.penalty_white[u] = CHARACTERS_OFFSET + rand() % (256 - CHARACTERS_OFFSET);
+				}
+			}
+
+			double reference = compareImages(img, mr.penalty_ink, mr.penalty_white);
+
+			GlyphMask mask;
+			buildGlyphMask(img, mask);
+
+			for (int level = 0; level < glyph_matching::klCount; level++)
+			{
+				glyph_matching::MaskedSumsFunction kernel = glyph_matching::getMaskedSumsKernel(level);
+				if (kernel == NULL)
+					continue;
+
+				double value = compareImages(mask, mr.penalty_ink, mr.penalty_white, kernel);
+				if (value != reference)
+				{
+					printf("  %s kernel mismatch: %g instead of %g\n", glyph_matching::getKernelLevelName(level), value, reference);
+					mismatches++;
+				}
+			}
+		}
+
+		return mismatches == 0;
+	}
+
+	bool testPrefilterBound()
+	{
+		using namespace CharacterRecognizerImp;
+
+		srand(9);
+		int violations = 0;
+
+		for (int iter = 0; iter < 300; iter++)
+		{
+			cv::Mat1b img = randomGlyph(rand() % 100);
+
+			MatchRecord mr;
+			calculatePenalties(randomGlyph(rand() % 100), mr.penalty_ink, mr.penalty_white);
+
+			GlyphMask mask;
+			buildGlyphMask(img, mask);
+			TemplateBits bits;
+			buildTemplateBits(mr, bits);
+
+			int bound = lowerBoundDistance(mask, bits);
+			double distance = compareImages(img, mr.penalty_ink, mr.penalty_white);
+			if (bound > distance)
+			{
+				printf("  prefilter bound %i exceeds distance %g\n", bound, distance);
+				violations++;
+			}
+		}
+
+		return violations == 0;
+	}
+
+	bool testPenalties()
+	{
+		using namespace CharacterRecognizerImp;
+
+		srand(5);
+		int mismatches = 0;
+
+		for (int iter = 0; iter < 60; iter++)
+		{
+			// include uniform images without ink or without white pixels
+			int ink_percent = (iter % 10 == 0) ? 0 : ((iter % 10 == 1) ? 100 : rand() % 100);
+			cv::Mat1b img = randomGlyph(ink_percent);
+
+			unsigned char reference_ink[INTERNAL_ARRAY_SIZE], reference_white[INTERNAL_ARRAY_SIZE];
+			unsigned char ink[INTERNAL_ARRAY_SIZE], white[INTERNAL_ARRAY_SIZE];
+			calculatePenaltiesReference(img, reference_ink, reference_white);
+			calculatePenalties(img, ink, white);
+
+			if (memcmp(ink, reference_ink, sizeof(ink)) != 0 || memcmp(white, reference_white, sizeof(white)) != 0)
+			{
+				printf("  penalties mismatch for %i%% ink\n", ink_percent);
+				mismatches++;
+			}
+		}
+
+		return mismatches == 0;
+	}
+
+	RecognitionDistance bruteForceRecognize(const Settings& vars, const cv::Mat1b& rect, 
+	                                        const CharacterRecognizerImp::Templates& templates)
+	{
+		using namespace CharacterRecognizerImp;
+
+		RecognitionDistance result;
+		double ratio;
+		cv::Mat1b img = prepareImage(vars, rect, ratio);
+
+		for (size_t u = 0; u < templates.size(); u++)
+		{
+			if (imago::absolute(ratio - templates[u].wh_ratio) >= vars.characters.RatioDiffThresh)
+				continue;
+
+			double distance = compareImages(img, templates[u].penalty_ink, templates[u].penalty_white) 
+				              / vars.characters.DistanceScaleFactor;
+			char c = templates[u].text[0];
+			result.setMinimum(c, distance);
+		}
+
+		return result;
+	}
+
+	bool testTemplateSearch()
+	{
+		using namespace CharacterRecognizerImp;
+
+		srand(13);
+		Settings vars;
+
+		Templates templates(300);
+		for (size_t u = 0; u < templates.size(); u++)
+		{
+			calculatePenalties(randomGlyph(20 + rand() % 40), templates[u].penalty_ink, templates[u].penalty_white);
+			templates[u].setText(std::string(1, (char)('a' + rand() % 20)));
+			templates[u].wh_ratio = 0.2 + (rand() % 200) / 100.0;
+		}
+
+		int mismatches = 0;
+		std::vector<cv::Mat1b> rects(100);
+		std::vector<RecognitionDistance> references(rects.size());
+		for (size_t iter = 0; iter < rects.size(); iter++)
+		{
+			cv::Mat1b& rect = rects[iter];
+			rect = cv::Mat1b(10 + rand() % 30, 10 + rand() % 30);
+			for (int y = 0; y < rect.rows; y++)
+				for (int x = 0; x < rect.cols; x++)
+					rect(y, x) = (rand() % 3 == 0) ? 0 : 255;
+			rect(0, 0) = rect(rect.rows - 1, rect.cols - 1) = 0; // keep the bounding box
+
+			references[iter] = bruteForceRecognize(vars, rect, templates);
+			RecognitionDistance result = recognizeMat(vars, rect, templates);
+			if (references[iter] != result)
+			{
+				printf("  template search mismatch: '%s' instead of '%s'\n", 
+					result.getRangedBest().c_str(), references[iter].getRangedBest().c_str());
+				mismatches++;
+			}
+		}
+
+		// the same with batch processing by several threads
+		std::vector<const cv::Mat1b*> images;
+		for (size_t iter = 0; iter < rects.size(); iter++)
+			images.push_back(&rects[iter]);
+
+		TemplateIndex index(templates);
+		std::vector<RecognitionDistance> results;
+		recognizeBatch(vars, images, index, results, 3);
+		for (size_t iter = 0; iter < rects.size(); iter++)
+		{
+			if (references[iter] != results[iter])
+			{
+				printf("  batch template search mismatch: '%s' instead of '%s'\n", 
+					results[iter].getRangedBest().c_str(), references[iter].getRangedBest().c_str());
+				mismatches++;
+			}
+		}
+
+		// coarse ranking keeping all the templates has to be exact
+		vars.characters.PyramidSurvivors = (int)templates.size();
+		recognizeBatch(vars, images, index, results, 2);
+		for (size_t iter = 0; iter < rects.size(); iter++)
+		{
+			if (references[iter] != results[iter])
+			{
+				printf("  pyramid template search mismatch: '%s' instead of '%s'\n", 
+					results[iter].getRangedBest().c_str(), references[iter].getRangedBest().c_str());
+				mismatches++;
+			}
+		}
+
+		return mismatches == 0;
+	}
+
+	bool testFontStorage()
+	{
+		using namespace CharacterRecognizerImp;
+
+		FontStorage embedded;
+		embedded.loadEmbedded();
+		if (embedded.getCount() == 0)
+			return false;
+
+		const std::string filename = "selftest.font";
+		Templates templates(embedded.getRecords(), embedded.getRecords() + embedded.getCount());
+		FontStorage::saveFile(filename, templates);
+
+		bool result = false;
+		{
+			FontStorage mapped;
+			mapped.loadFile(filename);
+			result = mapped.getCount() == embedded.getCount() &&
+			         memcmp(mapped.getRecords(), embedded.getRecords(), embedded.getCount() * sizeof(MatchRecord)) == 0;
+		}
+
+		remove(filename.c_str());
+		return result;
+	}
+
+	bool testSegmentator()
+	{
+		srand(29);
+		int mismatches = 0;
+
+		for (int iter = 0; iter < 200; iter++)
+		{
+			Image img(1 + rand() % 80, 1 + rand() % 80);
+			int density = rand() % 70;
+			for (int y = 0; y < img.getHeight(); y++)
+				for (int x = 0; x < img.getWidth(); x++)
+					img.getByte(x, y) = (rand() % 100 < density) ? 0 : 255;
+
+			int window = (iter % 4 == 0) ? 5 : 3;
+			SegmentDeque reference, runs;
+			Segmentator::segmentateReference(img, reference, window);
+			Segmentator::segmentate(img, runs, window);
+
+			bool same = reference.size() == runs.size();
+			for (size_t u = 0; same && u < runs.size(); u++)
+			{
+				const Segment& a = *reference[u];
+				const Segment& b = *runs[u];
+				same = a.getX() == b.getX() && a.getY() == b.getY() && a.getWidth() == b.getWidth() && a.getHeight() == b.getHeight();
+				for (int y = 0; same && y < a.getHeight(); y++)
+					same = memcmp(a.ptr(y), b.ptr(y), a.getWidth()) == 0;
+			}
+
+			if (!same)
+			{
+				printf("  segments mismatch: %u instead of %u\n", (unsigned int)runs.size(), (unsigned int)reference.size());
+				mismatches++;
+			}
+
+			for (size_t u = 0; u < reference.size(); u++)
+				delete reference[u];
+			for (size_t u = 0; u < runs.size(); u++)
+				delete runs[u];
+		}
+
+		return mismatches == 0;
+	}
+
+	bool testSegmentRuns()
+	{
+		srand(31);
+		int mismatches = 0;
+
+		for (int iter = 0; iter < 100; iter++)
+		{
+			Segment seg(1 + rand() % 40, 1 + rand() % 40, rand() % 30 - 10, rand() % 30 - 10);
+			int density = rand() % 100;
+			for (int y = 0; y < seg.getHeight(); y++)
+				for (int x = 0; x < seg.getWidth(); x++)
+					seg.getByte(x, y) = (rand() % 100 < density) ? 0 : 255;
+
+			SegmentRuns runs(seg);
+			Segment unpacked;
+			runs.unpack(unpacked);
+
+			bool same = unpacked.getX() == seg.getX() && unpacked.getY() == seg.getY() &&
+			            runs.getFilledCount() == SegmentTools::getFilledCount(seg);
+			for (int y = 0; same && y < seg.getHeight(); y++)
+				for (int x = 0; x < seg.getWidth(); x++)
+					if (unpacked.getByte(x, y) != seg.getByte(x, y) || runs.getByte(x, y) != seg.getByte(x, y))
+						same = false;
+
+			// drawing into an image clipping the segment
+			for (int careful = 0; careful <= 1; careful++)
+			{
+				Image dense(40, 40), packed(40, 40);
+				for (int y = 0; y < 40; y++)
+					for (int x = 0; x < 40; x++)
+						dense.getByte(x, y) = packed.getByte(x, y) = (rand() % 4 == 0) ? 0 : 255;
+
+				ImageUtils::putSegment(dense, seg, careful != 0);
+				ImageUtils::putSegment(packed, runs, careful != 0);
+				for (int y = 0; y < 40; y++)
+					if (memcmp(dense.ptr(y), packed.ptr(y), 40) != 0)
+						same = false;
+			}
+
+			if (!same)
+				mismatches++;
+		}
+
+		return mismatches == 0;
+	}
+
+	bool sameFeatures(const Segment& cached, const Segment& fresh)
+	{
+		const double* hu1 = SegmentTools::getHuMoments(cached);
+		const double* hu2 = SegmentTools::getHuMoments(fresh);
+		return SegmentTools::getFilledCount(cached) == SegmentTools::getFilledCount(fresh) &&
+		       SegmentTools::getRealHeight(cached) == SegmentTools::getRealHeight(fresh) &&
+		       SegmentTools::getEndpoints(cached) == SegmentTools::getEndpoints(fresh) &&
+		       memcmp(hu1, hu2, sizeof(double) * 7) == 0;
+	}
+
+	bool testSegmentFeatures()
+	{
+		srand(37);
+		int mismatches = 0;
+
+		for (int iter = 0; iter < 50; iter++)
+		{
+			Segment seg(2 + rand() % 30, 2 + rand() % 30, 0, 0);
+			int density = rand() % 100;
+			for (int y = 0; y < seg.getHeight(); y++)
+				for (int x = 0; x < seg.getWidth(); x++)
+					seg.getByte(x, y) = (rand() % 100 < density) ? 0 : 255;
+
+			// second request is served from the cache
+			bool same = sameFeatures(seg, Segment(seg));
+			int computed = seg.getFeatures().computed;
+			same = same && sameFeatures(seg, Segment(seg));
+			if (seg.getFeatures().computed != computed || seg.getFeatures().reused == 0)
+				same = false;
+
+			// geometry changes drop the cached values
+			seg.rotate90();
+			same = same && sameFeatures(seg, Segment(seg));
+			seg.crop();
+			same = same && sameFeatures(seg, Segment(seg));
+			if (seg.getFeatures().computed <= computed)
+				same = false;
+
+			if (!same)
+				mismatches++;
+		}
+
+		return mismatches == 0;
+	}
+
+	bool testSegmentIndex()
+	{
+		srand(41);
+		int mismatches = 0;
+
+		for (int iter = 0; iter < 20; iter++)
+		{
+			int width = 50 + rand() % 400, height = 50 + rand() % 400;
+			std::vector<Segment> storage(1 + rand() % 60);
+			SegmentIndex index(width, height, 8 + rand() % 40);
+			std::vector<Segment*> alive;
+
+			for (size_t u = 0; u < storage.size(); u++)
+			{
+				// some segments stick out of the indexed area
+				storage[u].init(1 + rand() % 50, 1 + rand() % 50);
+				storage[u].getX() = rand() % (width + 40) - 20;
+				storage[u].getY() = rand() % (height + 40) - 20;
+				index.insert(&storage[u]);
+				alive.push_back(&storage[u]);
+			}
+
+			// move some segments out of the index
+			for (size_t u = 0; u < storage.size() / 4; u++)
+			{
+				size_t victim = rand() % alive.size();
+				index.remove(alive[victim]);
+				alive.erase(alive.begin() + victim);
+			}
+
+			for (int q = 0; q < 50; q++)
+			{
+				Rectangle rect(rand() % width - 10, rand() % height - 10, 1 + rand() % 100, 1 + rand() % 100);
+				std::vector<Segment*> expected, found;
+				for (size_t u = 0; u < alive.size(); u++)
+				{
+					Rectangle r = alive[u]->getRectangle();
+					if (r.x1() < rect.x2() && rect.x1() < r.x2() && r.y1() < rect.y2() && rect.y1() < r.y2())
+						expected.push_back(alive[u]);
+				}
+				index.queryRect(rect, found);
+				if (found != expected)
+					mismatches++;
+
+				// nearest by center, earlier inserted wins on equal distance
+				Vec2i point(rand() % (width + 100) - 50, rand() % (height + 100) - 50);
+				size_t k = 1 + rand() % 5;
+				std::vector<Segment*> nearest = alive;
+				for (size_t a = 0; a < nearest.size(); a++)
+					for (size_t b = nearest.size() - 1; b > a; b--)
+						if (Vec2i::distance(point, nearest[b]->getCenter()) < Vec2i::distance(point, nearest[b - 1]->getCenter()))
+							std::swap(nearest[b], nearest[b - 1]);
+				if (nearest.size() > k)
+					nearest.resize(k);
+				index.queryNearest(point, k, found);
+				if (found != nearest)
+					mismatches++;
+			}
+		}
+
+		return mismatches == 0;
+	}
+
+	bool testRNG()
+	{
+		srand(43);
+		int mismatches = 0;
+
+		for (int iter = 0; iter < 60; iter++)
+		{
+			// random, coincident, collinear, cocircular and text line layouts
+			static const int circle[12][2] = { {3,4}, {4,3}, {-3,4}, {-4,3}, {3,-4}, {4,-3}, {-3,-4}, {-4,-3}, {5,0}, {-5,0}, {0,5}, {0,-5} };
+			int n = 1 + rand() % 150;
+			Points2d points(n);
+			for (int u = 0; u < n; u++)
+			{
+				switch (iter % 5)
+				{
+				case 0: points[u] = Vec2d(rand() % 1000 + (rand() % 2) * 0.5, rand() % 1000); break;
+				case 1: points[u] = Vec2d(rand() % 15 * 10, rand() % 15 * 12); break;
+				case 2: points[u] = Vec2d(rand() % 500, 100); break;
+				case 3: points[u] = Vec2d(rand() % 4 * 10 + circle[u % 12][0], rand() % 4 * 10 + circle[u % 12][1]); break;
+				default: points[u] = Vec2d(u % 20 * 16 + 8, u / 20 * 24 + 12); break;
+				}
+			}
+
+			std::vector<IntPair> edges, reference;
+			RNGBuilder::buildEdges(points, edges);
+			RNGBuilder::buildEdgesReference(points, reference);
+			if (edges != reference)
+				mismatches++;
+		}
+
+		return mismatches == 0;
+	}
+
+	bool testSegmentDistance()
+	{
+		srand(47);
+		int mismatches = 0;
+
+		for (int iter = 0; iter < 300; iter++)
+		{
+			// overlapping, touching and distant pairs, sparse and solid, some empty
+			Segment seg[2];
+			for (int k = 0; k < 2; k++)
+			{
+				seg[k].init(1 + rand() % 30, 1 + rand() % 30);
+				seg[k].getX() = rand() % 60;
+				seg[k].getY() = rand() % 60;
+				int density = (iter % 10 == 0) ? 0 : 1 + rand() % 100;
+				for (int y = 0; y < seg[k].getHeight(); y++)
+					for (int x = 0; x < seg[k].getWidth(); x++)
+						seg[k].getByte(x, y) = (rand() % 100 < density) ? 0 : 255;
+			}
+
+			for (int type = SegmentTools::dtEuclidian; type <= SegmentTools::dtDeltaY; type++)
+			{
+				SegmentTools::DistanceType t = (SegmentTools::DistanceType)type;
+				double fast = SegmentTools::getRealDistance(seg[0], seg[1], t);
+				if (fast != SegmentTools::getRealDistanceReference(seg[0], seg[1], t) ||
+					SegmentTools::getDistanceLowerBound(seg[0], seg[1], t) > fast)
+					mismatches++;
+			}
+		}
+
+		return mismatches == 0;
+	}
+
+	static bool checkLabels(const Image& img, const WeakSegmentator& ws)
+	{
+		int labeled = 0;
+		for (int id = 1; id <= ws.getSegmentsCount(); id++)
+		{
+			WeakSegmentator::PointsRange pts = ws.getSegmentPoints(id);
+			for (size_t u = 0; u < pts.size(); u++)
+				if (ws.getLabel(pts[u].x, pts[u].y) != id)
+					return false;
+			labeled += (int)pts.size();
+		}
+
+		int filled = 0;
+		for (int y = 0; y < img.getHeight(); y++)
+			for (int x = 0; x < img.getWidth(); x++)
+			{
+				if ((ws.getLabel(x, y) != 0) != (img.getByte(x, y) != 255))
+					return false;
+				if (img.getByte(x, y) != 255)
+					filled++;
+			}
+
+		return filled == labeled;
+	}
+
+	// segments found by flood fill over the pattern, numbered in raster order of their first pixels
+	static bool checkComponents(const Image& img, const Points2i& pattern, const WeakSegmentator& ws)
+	{
+		const int w = img.getWidth(), h = img.getHeight();
+		std::vector<int> ids(w * h, 0);
+		int count = 0;
+		for (int start = 0; start < w * h; start++)
+		{
+			if (ids[start] != 0 || img.getByte(start % w, start / w) == 255)
+				continue;
+
+			ids[start] = ++count;
+			std::vector<int> queue(1, start);
+			for (size_t u = 0; u < queue.size(); u++)
+			{
+				int x = queue[u] % w, y = queue[u] / w;
+				if (ws.getLabel(x, y) != count)
+					return false;
+				for (size_t v = 0; v < pattern.size(); v++)
+				{
+					int tx = x + pattern[v].x, ty = y + pattern[v].y;
+					if (tx >= 0 && ty >= 0 && tx < w && ty < h && ids[ty * w + tx] == 0 && img.getByte(tx, ty) != 255)
+					{
+						ids[ty * w + tx] = count;
+						queue.push_back(ty * w + tx);
+					}
+				}
+			}
+		}
+		return count == ws.getSegmentsCount();
+	}
+
+	bool testWeakSegmentator()
+	{
+		srand(47);
+
+		for (int iter = 0; iter < 50; iter++)
+		{
+			Image img(1 + rand() % 60, 1 + rand() % 60);
+			int density = rand() % 60;
+			for (int y = 0; y < img.getHeight(); y++)
+				for (int x = 0; x < img.getWidth(); x++)
+					img.getByte(x, y) = (rand() % 100 < density) ? 0 : 255;
+
+			Points2i pattern = WeakSegmentator::getLookupPattern(1 + iter % 3, iter % 2 == 0);
+			WeakSegmentator ws(img.getWidth(), img.getHeight());
+			ws.appendData(img, pattern);
+			if (!checkLabels(img, ws) || !checkComponents(img, pattern, ws))
+				return false;
+		}
+
+		// isolated pixels give more segments than 16-bit labels can hold
+		Image dots(600, 600);
+		for (int y = 0; y < dots.getHeight(); y++)
+			for (int x = 0; x < dots.getWidth(); x++)
+				dots.getByte(x, y) = (x % 2 == 0 && y % 2 == 0) ? 0 : 255;
+
+		WeakSegmentator ws(dots.getWidth(), dots.getHeight());
+		ws.appendData(dots, WeakSegmentator::getLookupPattern(1, false));
+		return ws.getSegmentsCount() == 300 * 300 && checkLabels(dots, ws) && ws.getLabel(598, 598) == 300 * 300;
+	}
+
+	bool testImagePrimitives()
+	{
+		srand(53);
+
+		for (int iter = 0; iter < 100; iter++)
+		{
+			// random blobs with white margins of random width
+			Image img(1 + rand() % 70, 1 + rand() % 70);
+			img.fillWhite();
+			int x1 = rand() % img.getWidth(), x2 = x1 + rand() % (img.getWidth() - x1);
+			int y1 = rand() % img.getHeight(), y2 = y1 + rand() % (img.getHeight() - y1);
+			bool empty = (iter % 10 == 0);
+			for (int y = y1; y <= y2 && !empty; y++)
+				for (int x = x1; x <= x2; x++)
+				{
+					int value = rand() % 4;
+					img.getByte(x, y) = (value == 0) ? 0 : (value == 1) ? (byte)(rand() % 256) : 255;
+				}
+
+			int black = 0, white = 0, other = 0;
+			int left = img.getWidth(), right = -1, top = img.getHeight(), bottom = -1;
+			for (int y = 0; y < img.getHeight(); y++)
+				for (int x = 0; x < img.getWidth(); x++)
+				{
+					byte value = img.getByte(x, y);
+					if (value == 0)
+						black++;
+					else if (value == 255)
+						white++;
+					else
+						other++;
+
+					if (value != 255)
+					{
+						left = std::min(left, x);
+						right = std::max(right, x);
+						top = std::min(top, y);
+						bottom = std::max(bottom, y);
+					}
+				}
+
+			int counts[3];
+			img.getColorCounts(counts[0], counts[1], counts[2]);
+			if (counts[0] != black || counts[1] != white || counts[2] != other)
+				return false;
+
+			// decorner against the neighbors lookup it replaced
+			Image expected, decorned;
+			expected.copy(img);
+			decorned.copy(img);
+			for (int y = 0; y < expected.getHeight(); y++)
+				for (int x = 0; x < expected.getWidth(); x++)
+					if (expected.isFilled(x, y) && SegmentTools::getInRange(expected, Vec2i(x, y), 1).size() > 2)
+						expected.getByte(x, y) = 255;
+			WeakSegmentator::decorner(decorned, 255);
+			for (int y = 0; y < expected.getHeight(); y++)
+				if (memcmp(expected.ptr(y), decorned.ptr(y), expected.getWidth()) != 0)
+					return false;
+
+			int shift_x = -1, shift_y = -1;
+			Image cropped;
+			cropped.copy(img);
+			cropped.crop(-1, -1, -1, -1, &shift_x, &shift_y);
+			if (right < 0)
+			{
+				if (cropped.getWidth() * cropped.getHeight() != 0)
+					return false;
+			}
+			else if (shift_x != left || shift_y != top ||
+			         cropped.getWidth() != right - left + 1 || cropped.getHeight() != bottom - top + 1)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool testRetinex()
+	{
+		Settings vars;
+		vars.general.WorkerThreads = 3;
+
+		// unevenly lit noisy page with strokes, odd width to check the crop
+		srand(59);
+		Image img(97, 64);
+		for (int y = 0; y < img.getHeight(); y++)
+			for (int x = 0; x < img.getWidth(); x++)
+			{
+				int value = 60 + x + y / 2 + rand() % 9;
+				if (x % 13 < 2 || (y % 17 < 2 && x > 20 && x < 70))
+					value -= 50;
+				img.getByte(x, y) = (byte)value;
+			}
+
+		Image fast, reference;
+		fast.copy(img);
+		reference.copy(img);
+		prefilter_retinex::retinexEnhance(vars, fast);
+		prefilter_retinex::retinexEnhanceReference(vars, reference);
+
+		if (fast.getWidth() != reference.getWidth() || fast.getHeight() != reference.getHeight())
+			return false;
+
+		// transforms are computed in single precision
+		int max_diff = 0, differ = 0;
+		for (int y = 0; y < fast.getHeight(); y++)
+			for (int x = 0; x < fast.getWidth(); x++)
+			{
+				int diff = std::abs((int)fast.getByte(x, y) - (int)reference.getByte(x, y));
+				max_diff = std::max(max_diff, diff);
+				if (diff > 1)
+					differ++;
+			}
+
+		return max_diff <= 3 && differ * 100 <= fast.getWidth() * fast.getHeight();
+	}
+
+	static bool sameMats(const cv::Mat& a, const cv::Mat& b)
+	{
+		if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type())
+			return false;
+		for (int y = 0; y < a.rows; y++)
+			if (memcmp(a.ptr(y), b.ptr(y), a.cols * a.elemSize()) != 0)
+				return false;
+		return true;
+	}
+
+	bool testPrefilterContext()
+	{
+		Settings vars;
+
+		// unevenly lit page with strokes, odd dimensions for the pyramid
+		srand(61);
+		Image img(301, 207);
+		for (int y = 0; y < img.getHeight(); y++)
+			for (int x = 0; x < img.getWidth(); x++)
+			{
+				int value = 120 + x / 4 + y / 3 + rand() % 9;
+				if ((x % 37 < 3 && y > 30 && y < 170) || (y % 29 < 3 && x > 40 && x < 260))
+					value -= 100;
+				img.getByte(x, y) = (byte)std::min(value, 255);
+			}
+
+		PrefilterContext context(img);
+
+		int black = 0, white = 0, other = 0, b = 0, w = 0, o = 0;
+		context.getColorCounts(black, white, other);
+		img.getColorCounts(b, w, o);
+		if (black != b || white != w || other != o)
+			return false;
+
+		// derived images are the same as computed directly
+		if (context.getLayer(img.size()).data != img.data)
+			return false;
+
+		cv::Size half(img.cols / 2, img.rows / 2);
+		cv::Mat resized;
+		cv::resize(img, resized, half, 0.0, 0.0, cv::INTER_AREA);
+		if (!sameMats(context.getLayer(half), resized))
+			return false;
+
+		cv::Mat reduced, smoothed, adaptive;
+		cv::pyrDown(img, reduced);
+		cv::pyrUp(reduced, smoothed);
+		cv::adaptiveThreshold(smoothed, adaptive, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY, 11, 5.0);
+		if (!sameMats(context.getSmoothed(img.size()), smoothed) || 
+			!sameMats(context.getAdaptiveThreshold(img.size(), 11, 5.0), adaptive))
+			return false;
+
+		// the filter on the context gives the same as on the image itself
+		Image direct, shared;
+		direct.copy(img);
+		prefilter_basic::prefilterBasicFullsize(vars, direct);
+		if (!prefilter_basic::prefilterBasicFullsize(vars, context, shared) || !sameMats(direct, shared))
+			return false;
+
+		// retry of the chain builds nothing new and gives the same output
+		Settings first_vars = vars, retry_vars = vars;
+		Image first, retry;
+		prefilterEntrypoint(first_vars, first, context);
+		int built = context.getBuiltCount(), hits = context.getHitCount();
+		prefilterEntrypoint(retry_vars, retry, context);
+		if (context.getBuiltCount() != built || context.getHitCount() <= hits || 
+			first_vars.general.FilterIndex != retry_vars.general.FilterIndex || !sameMats(first, retry))
+			return false;
+
+		context.reset();
+		return context.getMemoryUsage() == 0;
+	}
+
+	bool testFilterStatistics()
+	{
+		FilterEntries filters = getFiltersList();
+		if (filters.size() < 4)
+			return false;
+
+		FilterStatistics statistics;
+		std::vector<int> order;
+
+		// not enough samples keep the fixed order
+		statistics.getOrder("s1-i1-grey", filters, order);
+		for (size_t u = 0; u < filters.size(); u++)
+			if (order.size() != filters.size() || order[u] != (int)u)
+				return false;
+
+		// the first filter never gives a good result and goes last, the third one is good and faster than the second
+		for (int u = 0; u < FilterStatistics::MIN_SAMPLES; u++)
+		{
+			statistics.recordFilter("s1-i1-grey", filters[0].name, false, 1.0);
+			statistics.recordFilter("s1-i1-grey", filters[1].name, true, 300.0);
+			statistics.recordRecognition("s1-i1-grey", filters[1].name, u % 2 == 0, 900.0);
+			statistics.recordFilter("s1-i1-grey", filters[2].name, true, 30.0);
+			statistics.recordRecognition("s1-i1-grey", filters[2].name, true, 200.0);
+		}
+
+		statistics.getOrder("s1-i1-grey", filters, order);
+		if (order.size() != filters.size() || order[order.size() - 3] != 2 || order[order.size() - 2] != 1 ||
+			order[order.size() - 1] != 0)
+			return false;
+
+		// long running records are halved and keep their ratios
+		for (int u = 0; u < FilterStatistics::MAX_SAMPLES; u++)
+		{
+			statistics.recordFilter("s0-i0-bw", filters[3].name, true, 10.0);
+			statistics.recordRecognition("s0-i0-bw", filters[3].name, u % 2 == 0, 10.0);
+		}
+		FilterRecord decayed = statistics.getRecord("s0-i0-bw", filters[3].name);
+		if (decayed.attempts != FilterStatistics::MAX_SAMPLES / 2 || decayed.good * 2 > decayed.attempts + 1)
+			return false;
+
+		// other classes are not affected
+		std::vector<int> other_order;
+		statistics.getOrder("s3-i0-bw", filters, other_order);
+		if (other_order.size() != filters.size() || other_order[0] != 0)
+			return false;
+
+		statistics.setFrozen(true);
+		statistics.recordFilter("s1-i1-grey", filters[0].name, true, 1.0);
+		statistics.recordRecognition("s1-i1-grey", filters[0].name, true, 1.0);
+		FilterRecord record = statistics.getRecord("s1-i1-grey", filters[0].name);
+		if (record.attempts != FilterStatistics::MIN_SAMPLES || record.good != 0)
+			return false;
+
+		// the file keeps the records
+		const char* filename = "imago_selftest_filter_statistics.txt";
+		statistics.save(filename);
+		FilterStatistics loaded;
+		bool found = loaded.load(filename);
+		remove(filename);
+		if (!found)
+			return false;
+
+		std::vector<int> loaded_order;
+		loaded.getOrder("s1-i1-grey", filters, loaded_order);
+		record = loaded.getRecord("s1-i1-grey", filters[2].name);
+		return loaded_order == order && record.attempts == FilterStatistics::MIN_SAMPLES && 
+			record.good == FilterStatistics::MIN_SAMPLES && record.recognition_ms == 200.0 * FilterStatistics::MIN_SAMPLES;
+	}
+
+	bool testSymbolCache()
+	{
+		SymbolCache cache(2, 1);
+
+		SymbolCacheKey keys[3];
+		for (int u = 0; u < 3; u++)
+		{
+			keys[u].hash = u;
+			keys[u].context = 0;
+			keys[u].width = keys[u].height = 10;
+		}
+
+		RecognitionDistance rd;
+		rd.set('a', 1.0);
+
+		cache.insert(keys[0], rd);
+		cache.insert(keys[1], rd);
+
+		RecognitionDistance found;
+		if (!cache.find(keys[0], found) || found != rd) // keys[1] becomes the least recently used
+			return false;
+
+		cache.insert(keys[2], rd);
+
+		SymbolCacheStatistics stat = cache.getStatistics();
+		return !cache.find(keys[1], found) && cache.find(keys[2], found) && cache.find(keys[0], found) &&
+		       stat.evictions == 1 && stat.size == 2 && stat.hits == 1;
+	}
+
+	static const SelfTestEntry SelfTests[] = 
+	{
+		{ "glyph_kernels", testGlyphKernels },
+		{ "penalties", testPenalties },
+		{ "prefilter_bound", testPrefilterBound },
+		{ "template_search", testTemplateSearch },
+		{ "font_storage", testFontStorage },
+		{ "symbol_cache", testSymbolCache },
+		{ "segmentator", testSegmentator },
+		{ "segment_runs", testSegmentRuns },
+		{ "segment_features", testSegmentFeatures },
+		{ "segment_index", testSegmentIndex },
+		{ "rng", testRNG },
+		{ "segment_distance", testSegmentDistance },
+		{ "weak_segmentator", testWeakSegmentator },
+		{ "image_primitives", testImagePrimitives },
+		{ "retinex", testRetinex },
+		{ "prefilter_context", testPrefilterContext },
+		{ "filter_statistics", testFilterStatistics },
+	};
+
+	int performSelfTests(const std::string& name)
+	{
+		int passed = 0, failed = 0;
+
+		for (size_t u = 0; u < sizeof(SelfTests) / sizeof(SelfTests[0]); u++)
+		{
+			if (!name.empty() && name != SelfTests[u].name)
+				continue;
+
+			bool ok = false;
+			try
+			{
+				ok = SelfTests[u].routine();
+			}
+			catch (std::exception &e)
+			{
+				printf("  exception: %s\n", e.what());
+			}
+
+			printf("Self-test '%s': %s\n", SelfTests[u].name, ok ? "OK" : "FAILED");
+
+			if (ok)
+				passed++;
+			else
+				failed++;
+		}
+
+		printf("Self-tests: %u passed, %u failed\n", passed, failed);
+		return failed;
+	}
+}
@@ -0,0 +1,28 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+
+#ifndef _self_tests_h
+#define _self_tests_h
+
+#include <string>
+
+namespace self_tests
+{
+	// runs internal consistency checks (all of them if name is empty), returns count of failed ones
+	int performSelfTests(const std::string& name = "");
+}
+
+#endif // _self_tests_h
@@ -33,6 +33,8 @@
 #include "recognition_context.h"
 #include "prefilter_entry.h"
 #include "filters_list.h"
+#include "font_registry.h"
+#include "symbol_cache.h"
 
 #define IMAGO_BEGIN try {                                                    
 
@@ -140,8 +142,9 @@ CEXPORT int imagoLoadImageFromFile( const char *FileName )
    IMAGO_BEGIN;
 
    RecognitionContext *context = getCurrentContext();
-   ImageUtils::loadImageFromFile(context->img_src, FileName);
+   ImageUtils::loadImageFromFileReduced(context->img_src, context->vars.csr.ReducedDecodeDimensions, "%s", FileName);
    context->img_tmp = context->img_src;
+   context->prefilter.reset();
       
    IMAGO_END;
 }
@@ -151,7 +154,7 @@ CEXPORT int imagoFilterImage()
    IMAGO_BEGIN;
    
    RecognitionContext *context = getCurrentContext();   
-   prefilterEntrypoint(context->vars, context->img_tmp, context->img_src);
+   prefilterEntrypoint(context->vars, context->img_tmp, context->prefilter);
 
    IMAGO_END;
 }
@@ -162,8 +165,14 @@ CEXPORT int imagoLoadImageFromBuffer( const char *buf, const int buf_size )
    
    RecognitionContext *context = getCurrentContext();
    const unsigned char* buf_uc = (const unsigned char*)buf;
-   failsafePngLoadBuffer(buf_uc, buf_size, context->img_src);
+   if (!failsafePngLoadBuffer(buf_uc, buf_size, context->img_src))
+   {
+      // JPEG and the other formats are decoded by OpenCV, reduced as the files are
+      std::vector<byte> buffer(buf_uc, buf_uc + buf_size);
+      ImageUtils::loadImageFromBuffer(buffer, context->img_src, context->vars.csr.ReducedDecodeDimensions);
+   }
    context->img_tmp = context->img_src;
+   context->prefilter.reset();
 
    IMAGO_END;
 }
@@ -184,6 +193,7 @@ CEXPORT int imagoLoadGreyscaleRawImage( const char *buf, const int width, const
 		   img.getByte(x,y) = buf[y * width + x];
 
    context->img_tmp = context->img_src;
+   context->prefilter.reset();
 
    IMAGO_END;
 }
@@ -310,6 +320,33 @@ CEXPORT int imagoSaveMolToBuffer( char **buf, int *buf_size )
    IMAGO_END;
 }
 
+CEXPORT int imagoRegisterFontFile( const char *FileName )
+{
+   IMAGO_BEGIN;
+
+   CharacterRecognizerImp::FontRegistry::getInstance().registerFontFile(FileName);
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoGetSymbolCacheStatistics( qword *hits, qword *misses, qword *evictions, int *size )
+{
+   IMAGO_BEGIN;
+
+   SymbolCacheStatistics stat = SymbolCache::getShared().getStatistics();
+
+   if (hits != NULL)
+      *hits = stat.hits;
+   if (misses != NULL)
+      *misses = stat.misses;
+   if (evictions != NULL)
+      *evictions = stat.evictions;
+   if (size != NULL)
+      *size = (int)stat.size;
+
+   IMAGO_END;
+}
+
 CEXPORT int imagoSetLogging( int mode )
 {
    IMAGO_BEGIN;
@@ -77,7 +77,9 @@ CEXPORT const char* imagoGetConfigsList();
  * By default, filter from current config will be used. */
 CEXPORT int imagoSetFilter( const char *name );
 
-/* Image loading functions. */
+/* Image loading functions. JPEG images much larger than the current config
+ * expects (csr.ReducedDecodeDimensions) are decoded at 1/2, 1/4 or 1/8 scale.
+ * Buffers which are not PNG are decoded the same way as files. */
 CEXPORT int imagoLoadImageFromBuffer( const char *buf, const int buf_size );
 CEXPORT int imagoLoadImageFromFile( const char *FileName );
 
@@ -87,6 +89,15 @@ CEXPORT int imagoSaveImageToFile( const char *FileName );
 /* Load raw grayscale image - byte array of length width*height. */
 CEXPORT int imagoLoadGreyscaleRawImage( const char *buf, const int width, const int height );
 
+/* Register additional binary font file (see imago_console -makefont),
+ * its templates are used together with the default ones.
+ * WARNING: affects all threads/IDS */
+CEXPORT int imagoRegisterFontFile( const char *FileName );
+
+/* Get counters of the symbol recognition cache shared by all instances.
+ * Any of the pointers may be NULL. */
+CEXPORT int imagoGetSymbolCacheStatistics( qword *hits, qword *misses, qword *evictions, int *size );
+
 /* Enable or disable global log printing */
 /* Modes are: 0 - disabled, 1 - enable log to file, 2 - enable log to virtual fs*/
 /* WARNING: affects all threads/IDS */
@@ -21,6 +21,7 @@
 #include "comdef.h"
 #include "chemical_structure_recognizer.h"
 #include "image.h"
+#include "prefilter_context.h"
 #include "molecule.h"
 #include "settings.h"
 #include "virtual_fs.h"
@@ -33,6 +34,7 @@ namespace imago
       ChemicalStructureRecognizer csr;
       Image img_tmp;
 	  Image img_src;
+	  PrefilterContext prefilter; // of img_src, reset when it is loaded
       Molecule mol;
       std::string molfile;
       std::string out_buf;
@@ -42,7 +44,7 @@ namespace imago
       VirtualFS vfs;
       void *session_specific_data;
       
-      RecognitionContext () 
+      RecognitionContext () : prefilter(img_src)
       {
          session_specific_data = 0;
          error_buf = "No error";
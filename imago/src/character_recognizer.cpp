@@ -17,10 +17,12 @@
 #include <sstream>
 #include <boost/foreach.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <boost/thread.hpp>
 #include <map>
 #include <cmath>
 #include <cfloat>
 #include <deque>
+#include <algorithm>
 #include <opencv2/opencv.hpp>
 #include <string.h> // memcpy
 #include "stl_fwd.h"
@@ -35,6 +37,8 @@
 #include "recognition_tree.h"
 #include "settings.h"
 #include "fonts_list.h"
+#include "font_registry.h"
+#include "symbol_cache.h"
 #include "file_helpers.h"
 #include "platform_tools.h"
 
@@ -89,36 +93,6 @@ bool imago::CharacterRecognizer::isPossibleCharacter(const Settings& vars, const
 	return false;
 }
 
-qword CharacterRecognizer::getSegmentHash(const Segment &seg) 
-{
-	logEnterFunction();
-
-	qword segHash = 0, shift = 0;
-   
-	// hash against the source pixels
-	for (int y = 0; y < seg.getHeight(); y++)
-	{
-		for (int x = 0; x < seg.getWidth(); x++)
-			if (seg.getByte(x,y) == 0) // ink
-			{
-				shift = (shift << 1) + x * 3 + y * 7;
-				segHash ^= shift;
-			}
-	}
-
-	return segHash;
-}
-
-void internalInitTemplates(imago::CharacterRecognizerImp::Templates& templates)
-{	
-	//unsigned int start = platform::TICKS();
-	{
-		#include "font.inc"
-	}
-	//printf("Loaded font (%u entries) in %u ms\n", templates.size(), platform::TICKS() - start);
-}
-
-
 RecognitionDistance CharacterRecognizer::recognize(const Settings& vars, const Segment &seg, const std::string &candidates) const
 {
 	logEnterFunction();
@@ -126,54 +100,91 @@ RecognitionDistance CharacterRecognizer::recognize(const Settings& vars, const S
 	getLogExt().appendSegment("Source segment", seg);
 	getLogExt().append("Candidates", candidates);
 
-	qword segHash = getSegmentHash(seg);	
-	getLogExt().append("Segment hash", segHash);
+	SymbolCacheKey key = SymbolCache::makeKey(vars, seg);
+	getLogExt().append("Segment hash", key.hash);
 	RecognitionDistance rec;
    
 	if (vars.caches.PCacheSymbolsRecognition &&
-		vars.caches.PCacheSymbolsRecognition->find(segHash) != vars.caches.PCacheSymbolsRecognition->end())
+		vars.caches.PCacheSymbolsRecognition->find(key, rec))
 	{
-		rec = (*vars.caches.PCacheSymbolsRecognition)[segHash];
 		getLogExt().appendText("Used cache: clean");
 	}
 	else
 	{
-		static bool init = false;
-		static CharacterRecognizerImp::Templates templates;
-		
-		if (!init)
-		{
-			internalInitTemplates(templates);
-			init = true;
-		}
+		boost::shared_ptr<const CharacterRecognizerImp::TemplateIndex> index = 
+			CharacterRecognizerImp::FontRegistry::getInstance().getIndex();
 
-		rec = CharacterRecognizerImp::recognizeMat(vars, seg, templates);
-		getLogExt().appendMap("Font recognition result", rec);
+		rec = CharacterRecognizerImp::recognizeMat(vars, seg, *index);
+		if (getLogExt().loggingEnabled())
+			getLogExt().appendMap("Font recognition result", rec.toMap());
 
 		if (vars.caches.PCacheSymbolsRecognition)
 		{
-			(*vars.caches.PCacheSymbolsRecognition)[segHash] = rec;
+			vars.caches.PCacheSymbolsRecognition->insert(key, rec);
 			getLogExt().appendText("Filled cache: clean");
 		}
 	}
 
-	RecognitionDistance result;
+	rec.filter(CharacterMask(candidates));
+
+	if (getLogExt().loggingEnabled())
+	{
+		getLogExt().append("Result candidates", rec.getBest());
+		getLogExt().append("Recognition quality", rec.getQuality());
+	}
+
+   return rec;
+}
+
+void CharacterRecognizer::recognizeBatch(const Settings& vars, const std::vector<Segment*>& segs, 
+                                         std::vector<RecognitionDistance>& results, const std::string &candidates) const
+{
+	logEnterFunction();
+
+	getLogExt().append("Batch size", segs.size());
+	getLogExt().append("Candidates", candidates);
+
+	std::vector<RecognitionDistance> full(segs.size());
+	std::vector<SymbolCacheKey> keys(segs.size());
+	std::vector<size_t> missing;
+	std::vector<const cv::Mat1b*> images;
 
-	for (RecognitionDistance::iterator it = rec.begin(); it != rec.end(); it++)
+	for (size_t u = 0; u < segs.size(); u++)
 	{
-		if (candidates.find(it->first) != std::string::npos)
+		keys[u] = SymbolCache::makeKey(vars, *segs[u]);
+		if (!vars.caches.PCacheSymbolsRecognition || !vars.caches.PCacheSymbolsRecognition->find(keys[u], full[u]))
 		{
-			result[it->first] = it->second;
+			missing.push_back(u);
+			images.push_back(segs[u]);
 		}
 	}
 
-	if (getLogExt().loggingEnabled())
+	getLogExt().append("Used cache for segments", segs.size() - missing.size());
+
+	if (!missing.empty())
 	{
-		getLogExt().append("Result candidates", result.getBest());
-		getLogExt().append("Recognition quality", result.getQuality());
+		boost::shared_ptr<const CharacterRecognizerImp::TemplateIndex> index = 
+			CharacterRecognizerImp::FontRegistry::getInstance().getIndex();
+
+		int threads = vars.general.WorkerThreads;
+		if (threads <= 0)
+			threads = std::max(1, (int)boost::thread::hardware_concurrency());
+
+		std::vector<RecognitionDistance> computed;
+		CharacterRecognizerImp::recognizeBatch(vars, images, *index, computed, threads);
+
+		for (size_t u = 0; u < missing.size(); u++)
+		{
+			full[missing[u]] = computed[u];
+			if (vars.caches.PCacheSymbolsRecognition)
+				vars.caches.PCacheSymbolsRecognition->insert(keys[missing[u]], computed[u]);
+		}
 	}
 
-   return result;
+	CharacterMask mask(candidates);
+	results.swap(full);
+	for (size_t u = 0; u < results.size(); u++)
+		results[u].filter(mask);
 }
 
 
@@ -202,7 +213,7 @@ namespace imago
 
 		static CircleOffsetPoints offsets(REQUIRED_SIZE);
 
-		void calculatePenalties(const cv::Mat1b& img, unsigned char* penalty_ink, unsigned char* penalty_white)
+		void calculatePenaltiesReference(const cv::Mat1b& img, unsigned char* penalty_ink, unsigned char* penalty_white)
 		{				
 			for (int y = -PENALTY_SHIFT; y < REQUIRED_SIZE + PENALTY_SHIFT; y++)
 				for (int x = -PENALTY_SHIFT; x < REQUIRED_SIZE + PENALTY_SHIFT; x++)
@@ -241,6 +252,113 @@ namespace imago
 				}	
 		}
 
+		const int EDT_INFINITY = 1 << 28;
+
+		// squared euclidean distance from every penalty cell to the nearest pixel of specified value,
+		// separable transform by Felzenszwalb and Huttenlocher, linear in the cells count
+		static void squaredDistances(const cv::Mat1b& img, int value, int* result)
+		{
+			const int n = img.rows;
+
+			// vertical pass: squared distance to the nearest feature in the same image column
+			std::vector<int> column(n * INTERNAL_ARRAY_DIM);
+			std::vector<int> nearest(INTERNAL_ARRAY_DIM);
+			for (int i = 0; i < n; i++)
+			{
+				int* g = &column[i * INTERNAL_ARRAY_DIM];
+
+				int last = -1;
+				for (int yy = 0; yy < INTERNAL_ARRAY_DIM; yy++)
+				{
+					int y = yy - PENALTY_SHIFT;
+					if (y >= 0 && y < n && img(y, i) == value)
+						last = yy;
+					nearest[yy] = (last < 0) ? EDT_INFINITY : yy - last;
+				}
+
+				last = -1;
+				for (int yy = INTERNAL_ARRAY_DIM - 1; yy >= 0; yy--)
+				{
+					int y = yy - PENALTY_SHIFT;
+					if (y >= 0 && y < n && img(y, i) == value)
+						last = yy;
+					if (last >= 0 && last - yy < nearest[yy])
+						nearest[yy] = last - yy;
+					g[yy] = (nearest[yy] >= EDT_INFINITY) ? EDT_INFINITY : nearest[yy] * nearest[yy];
+				}
+			}
+
+			// horizontal pass: lower envelope of parabolas rooted at image columns
+			std::vector<int> v(n);
+			std::vector<double> z(n + 1);
+			for (int yy = 0; yy < INTERNAL_ARRAY_DIM; yy++)
+			{
+				int k = -1;
+				for (int q = 0; q < n; q++)
+				{
+					int fq = column[q * INTERNAL_ARRAY_DIM + yy];
+					if (fq >= EDT_INFINITY)
+						continue;
+
+					double s = -DIST_INF;
+					while (k >= 0)
+					{
+						int fv = column[v[k] * INTERNAL_ARRAY_DIM + yy];
+						s = ((double)(fq + q * q) - (double)(fv + v[k] * v[k])) / (2.0 * (q - v[k]));
+						if (s > z[k])
+							break;
+						k--;
+					}
+
+					k++;
+					v[k] = q;
+					z[k] = (k == 0) ? -DIST_INF : s;
+					z[k + 1] = DIST_INF;
+				}
+
+				int* row = result + yy * INTERNAL_ARRAY_DIM;
+				for (int xx = 0, e = 0; xx < INTERNAL_ARRAY_DIM; xx++)
+				{
+					if (k < 0)
+					{
+						row[xx] = EDT_INFINITY;
+						continue;
+					}
+
+					int x = xx - PENALTY_SHIFT;
+					while (z[e + 1] < x)
+						e++;
+					row[xx] = (x - v[e]) * (x - v[e]) + column[v[e] * INTERNAL_ARRAY_DIM + yy];
+				}
+			}
+		}
+
+		void calculatePenalties(const cv::Mat1b& img, unsigned char* penalty_ink, unsigned char* penalty_white)
+		{
+			if (img.rows != img.cols)
+				throw ImagoException("Penalties require square image");
+
+			// the reference implementation takes the first circle of rounded radius containing a pixel of
+			// required value; rounding sqrt is monotonic, so it is the rounded nearest distance capped by REQUIRED_SIZE
+			int distances[INTERNAL_ARRAY_SIZE];
+			for (int value = 0; value <= 255; value += 255)
+			{
+				squaredDistances(img, value, distances);
+
+				for (int idx = 0; idx < INTERNAL_ARRAY_SIZE; idx++)
+				{
+					int min_dist = REQUIRED_SIZE;
+					if (distances[idx] < EDT_INFINITY)
+						min_dist = std::min(REQUIRED_SIZE, imago::round(sqrt((double)distances[idx])));
+
+					if (value == 0)
+						penalty_ink[idx] = std::min(255, CHARACTERS_OFFSET + min_dist);
+					else
+						penalty_white[idx] = std::min(255, CHARACTERS_OFFSET + imago::round(PENALTY_WHITE_FACTOR * sqrt((double)min_dist)));
+				}
+			}
+		}
+
 		double compareImages(const cv::Mat1b& img, const unsigned char* penalty_ink, const unsigned char* penalty_white)
 		{
 			double best = imago::DIST_INF;
@@ -277,6 +395,190 @@ namespace imago
 			return best;
 		}
 
+		void buildGlyphMask(const cv::Mat1b& img, GlyphMask& mask)
+		{
+			if (img.cols != REQUIRED_SIZE || img.rows != REQUIRED_SIZE)
+				throw ImagoException("Glyph mask requires prepared image");
+
+			memset(mask.ink, 0, sizeof(mask.ink));
+			memset(mask.white, 0, sizeof(mask.white));
+			memset(mask.ink_block_count, 0, sizeof(mask.ink_block_count));
+			memset(mask.white_block_count, 0, sizeof(mask.white_block_count));
+			memset(mask.ink_bits, 0, sizeof(mask.ink_bits));
+			memset(mask.white_bits, 0, sizeof(mask.white_bits));
+			memset(mask.coarse_ink, 0, sizeof(mask.coarse_ink));
+			mask.ink_count = mask.white_count = 0;
+
+			for (int y = 0; y < img.cols; y++)
+			{
+				const unsigned char* row = img.ptr(y);
+				int offset = (y + PENALTY_SHIFT) * INTERNAL_ARRAY_DIM + PENALTY_SHIFT;
+				int block = offset / GLYPH_BLOCK_SIZE;
+				unsigned char* ink = mask.ink + offset;
+				unsigned char* white = mask.white + offset;
+				unsigned char* coarse_ink = mask.coarse_ink + (y / COARSE_FACTOR) * COARSE_DIM;
+				for (int x = 0; x < img.rows; x++)
+				{
+					int cell = offset + x;
+					qword bit = (qword)1 << (cell % 64);
+					if (row[x] == 0)
+					{
+						ink[x] = 0xFF;
+						mask.ink_count++;
+						mask.ink_block_count[block]++;
+						mask.ink_bits[cell / 64] |= bit;
+						coarse_ink[x / COARSE_FACTOR]++;
+					}
+					else
+					{
+						white[x] = 0xFF;
+						mask.white_count++;
+						mask.white_block_count[block]++;
+						mask.white_bits[cell / 64] |= bit;
+					}
+				}
+			}
+		}
+
+		double compareImages(const GlyphMask& mask, const unsigned char* penalty_ink, const unsigned char* penalty_white,
+		                     glyph_matching::MaskedSumsFunction kernel)
+		{
+			// the reference implementation evaluates every (shift_x, shift_y) pair against the
+			// same penalty cells, so all shifts produce the same sums and one pass is enough
+			if (kernel == NULL)
+				kernel = glyph_matching::getBestMaskedSumsKernel();
+
+			int sum_ink = 0, sum_white = 0;
+			kernel(mask.ink, mask.white, penalty_ink, penalty_white, INTERNAL_ARRAY_SIZE, sum_ink, sum_white);
+
+			// masked cells contribute (penalty - CHARACTERS_OFFSET) each
+			sum_ink -= CHARACTERS_OFFSET * mask.ink_count;
+			sum_white -= CHARACTERS_OFFSET * mask.white_count;
+
+			return (double)sum_ink + (double)sum_white / (double)PENALTY_WHITE_FACTOR;
+		}
+
+		bool compareImagesBounded(const GlyphMask& mask, const unsigned char* penalty_ink, const unsigned char* penalty_white,
+		                          double bound, double& distance, glyph_matching::MaskedSumsFunction kernel)
+		{
+			if (kernel == NULL)
+				kernel = glyph_matching::getBestMaskedSumsKernel();
+
+			// every penalty is not less than CHARACTERS_OFFSET, so partial distances never decrease
+			int total_ink = 0, total_white = 0;
+			for (int block = 0; block < GLYPH_BLOCKS; block++)
+			{
+				int offset = block * GLYPH_BLOCK_SIZE;
+				int sum_ink = 0, sum_white = 0;
+				kernel(mask.ink + offset, mask.white + offset, penalty_ink + offset, penalty_white + offset,
+				       GLYPH_BLOCK_SIZE, sum_ink, sum_white);
+
+				total_ink += sum_ink - CHARACTERS_OFFSET * mask.ink_block_count[block];
+				total_white += sum_white - CHARACTERS_OFFSET * mask.white_block_count[block];
+
+				distance = (double)total_ink + (double)total_white / (double)PENALTY_WHITE_FACTOR;
+				if (distance > bound)
+					return false;
+			}
+			return true;
+		}
+
+		void buildTemplateBits(const MatchRecord& mr, TemplateBits& bits)
+		{
+			memset(&bits, 0, sizeof(bits));
+
+			for (int cell = 0; cell < INTERNAL_ARRAY_SIZE; cell++)
+			{
+				qword bit = (qword)1 << (cell % 64);
+				if (mr.penalty_ink[cell] <= CHARACTERS_OFFSET)
+					bits.ink[cell / 64] |= bit;
+				if (mr.penalty_ink[cell] <= CHARACTERS_OFFSET + 1)
+					bits.ink_near[cell / 64] |= bit;
+				if (mr.penalty_white[cell] < CHARACTERS_OFFSET + PENALTY_WHITE_FACTOR)
+					bits.white[cell / 64] |= bit;
+			}
+		}
+
+		void buildTemplateCoarse(const MatchRecord& mr, TemplateCoarse& coarse)
+		{
+			double ink[COARSE_SIZE] = {0.0};
+			double white[COARSE_SIZE] = {0.0};
+			double base = 0.0;
+
+			for (int y = 0; y < REQUIRED_SIZE; y++)
+			{
+				for (int x = 0; x < REQUIRED_SIZE; x++)
+				{
+					int idx = (y + PENALTY_SHIFT) * INTERNAL_ARRAY_DIM + (x + PENALTY_SHIFT);
+					int cell = (y / COARSE_FACTOR) * COARSE_DIM + x / COARSE_FACTOR;
+					double w = (double)(mr.penalty_white[idx] - CHARACTERS_OFFSET) / (double)PENALTY_WHITE_FACTOR;
+					ink[cell] += mr.penalty_ink[idx] - CHARACTERS_OFFSET;
+					white[cell] += w;
+					base += w;
+				}
+			}
+
+			const double cell_area = COARSE_FACTOR * COARSE_FACTOR;
+			for (int cell = 0; cell < COARSE_SIZE; cell++)
+				coarse.ink_gain[cell] = (float)((ink[cell] - white[cell]) / cell_area);
+			coarse.base = (float)base;
+		}
+
+		double coarseDistance(const GlyphMask& mask, const TemplateCoarse& coarse)
+		{
+			float result = coarse.base;
+			for (int cell = 0; cell < COARSE_SIZE; cell++)
+				result += mask.coarse_ink[cell] * coarse.ink_gain[cell];
+			return result;
+		}
+
+		int lowerBoundDistance(const GlyphMask& mask, const TemplateBits& bits)
+		{
+			int result = 0;
+			for (int w = 0; w < GLYPH_BIT_WORDS; w++)
+			{
+				result += glyph_matching::popcount(mask.ink_bits[w] & ~bits.ink[w]);
+				result += glyph_matching::popcount(mask.ink_bits[w] & ~bits.ink_near[w]);
+				result += glyph_matching::popcount(mask.white_bits[w] & ~bits.white[w]);
+			}
+			return result;
+		}
+
+		void MatchRecord::setText(const std::string& value)
+		{
+			memset(text, 0, sizeof(text));
+			value.copy(text, MATCH_TEXT_SIZE - 1);
+		}
+
+		TemplateIndex::TemplateIndex(const Templates& templates)
+		{
+			if (!templates.empty())
+				addRecords(&templates[0], templates.size());
+		}
+
+		TemplateIndex::TemplateIndex(const MatchRecord* records, size_t count)
+		{
+			addRecords(records, count);
+		}
+
+		void TemplateIndex::addRecords(const MatchRecord* records, size_t count)
+		{
+			for (size_t u = 0; u < count; u++)
+			{
+				// Imago supports only one-char-length templates, TODO: upgrade
+				if (records[u].text[0] == 0 || records[u].text[1] != 0)
+					continue;
+
+				RatioEntry entry;
+				entry.wh_ratio = records[u].wh_ratio;
+				entry.record = &records[u];
+				buildTemplateBits(records[u], entry.bits);
+				buildTemplateCoarse(records[u], entry.coarse);
+				_entries.push_back(entry);
+			}
+			std::sort(_entries.begin(), _entries.end());
+		}
+
 		cv::Mat1b prepareImage(const Settings& vars, const cv::Mat1b& src, double &ratio)
 		{
 			imago::Image temp;
@@ -354,7 +656,7 @@ namespace imago
 			{
 				MatchRecord mr;
 				cv::Mat1b image = load(files[u]);
-				mr.text = convertFileNameToLetter(files[u]);
+				mr.setText(convertFileNameToLetter(files[u]));
 				if (!image.empty())
 				{
 					cv::Mat1b prepared = prepareImage(vars, image, mr.wh_ratio);
@@ -365,78 +667,207 @@ namespace imago
 			return !templates.empty();
 		}
 
-		struct ResultEntry
+		imago::RecognitionDistance recognizeMat(const Settings& vars, const cv::Mat1b& rect, const Templates& templates)
 		{
-			double value;
-			std::string text;
-			ResultEntry(double _value, std::string _text)
-			{
-				value = _value;
-				text = _text;
-			}
-			bool operator <(const ResultEntry& second) const
-			{
-				if (this->value < second.value)
-					return true;
-				else
-					return false;
-			}
-		};
+			TemplateIndex index(templates);
+			return recognizeMat(vars, rect, index);
+		}
 
-		imago::RecognitionDistance recognizeMat(const Settings& vars, const cv::Mat1b& rect, const Templates& templates)
+		imago::RecognitionDistance recognizeMat(const Settings& vars, const cv::Mat1b& rect, const TemplateIndex& index)
 		{
-			imago::RecognitionDistance _result;
+			std::vector<const cv::Mat1b*> images(1, &rect);
+			std::vector<RecognitionDistance> results;
+			recognizeBatch(vars, images, index, results);
+			return results[0];
+		}
 
-			std::vector<ResultEntry> results;
-		
+		// prepared image with the best distances found per character
+		struct BatchGlyph
+		{
+			GlyphMask mask;
 			double ratio;
-			cv::Mat1b img;
-			try
+			double best[256];
+			bool found[256];
+		};
+
+		struct BatchRatioLess
+		{
+			const std::vector<BatchGlyph>* glyphs;
+			bool operator()(size_t a, size_t b) const { return (*glyphs)[a].ratio < (*glyphs)[b].ratio; }
+		};
+
+		struct BatchWorker
+		{
+			const TemplateIndex* index;
+			std::vector<BatchGlyph>* glyphs;
+			const size_t* first; // glyph indexes ordered by ratio
+			const size_t* last;
+			double max_diff;
+			int compared;
+			int rejected; // by the popcount prefilter
+			int survivors; // templates verified after coarse ranking, all compatible ones if not positive
+			std::vector<std::pair<double, size_t> > ranked;
+
+			void operator()()
 			{
-				img = prepareImage(vars, rect, ratio);
+				if (survivors > 0)
+					rankedScan();
+				else
+					fullScan();
 			}
-			catch (ImagoException& e)
+
+			void compareTemplate(BatchGlyph& g, size_t t)
 			{
-				getLogExt().append("Exception", e.what());
-				return _result;
+				const MatchRecord& mr = index->getRecord(t);
+				const unsigned char c = (unsigned char)mr.text[0];
+
+				// only the best distance per character is stored in result, so each template
+				// is compared against the best one found for its character so far
+				if (lowerBoundDistance(g.mask, index->getBits(t)) > g.best[c])
+				{
+					rejected++;
+					return;
+				}
+
+				compared++;
+				double distance;
+				if (compareImagesBounded(g.mask, mr.penalty_ink, mr.penalty_white, g.best[c], distance) && distance <= g.best[c])
+				{
+					g.best[c] = distance;
+					g.found[c] = true;
+				}
 			}
 
-			for (size_t u = 0; u < templates.size(); u++)
+			void fullScan()
 			{
-				// Imago supports only one-char-length templates, TODO: upgrade
-				if (templates[u].text.size() != 1)
-					continue;
-
-				try
+				const size_t* low = first;
+				for (size_t t = 0; t < index->size(); t++)
 				{
-					double distance = compareImages(img, templates[u].penalty_ink, templates[u].penalty_white);
-					double ratio_diff = imago::absolute(ratio - templates[u].wh_ratio);
-				
-					if (ratio_diff < vars.characters.RatioDiffThresh)
+					const double wh_ratio = index->getRatio(t);
+
+					// both templates and glyphs are ordered by ratio, so the compatible window only moves forward;
+					// the window is widened by EPS and every pair is checked precisely
+					while (low < last && (*glyphs)[*low].ratio < wh_ratio - max_diff - EPS)
+						low++;
+
+					for (const size_t* p = low; p < last && (*glyphs)[*p].ratio <= wh_ratio + max_diff + EPS; p++)
 					{
-						results.push_back(ResultEntry(distance, templates[u].text));
+						BatchGlyph& g = (*glyphs)[*p];
+						if (imago::absolute(g.ratio - wh_ratio) < max_diff)
+							compareTemplate(g, t);
 					}
 				}
-				catch(std::exception& e)
+			}
+
+			void rankedScan()
+			{
+				for (const size_t* p = first; p < last; p++)
 				{
-					printf("Exception: %s\n", e.what());
+					BatchGlyph& g = (*glyphs)[*p];
+
+					ranked.clear();
+					for (size_t t = 0; t < index->size(); t++)
+						if (imago::absolute(g.ratio - index->getRatio(t)) < max_diff)
+							ranked.push_back(std::make_pair(coarseDistance(g.mask, index->getCoarse(t)), t));
+
+					size_t count = std::min(ranked.size(), (size_t)survivors);
+					std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end());
+
+					for (size_t u = 0; u < count; u++)
+						compareTemplate(g, ranked[u].second);
 				}
 			}
+		};
 
-			if (results.empty())
-				return _result;
+		void recognizeBatch(const Settings& vars, const std::vector<const cv::Mat1b*>& images, const TemplateIndex& index,
+		                    std::vector<RecognitionDistance>& results, int threads)
+		{
+			results.assign(images.size(), RecognitionDistance());
 
-			std::sort(results.begin(), results.end());
+			std::vector<BatchGlyph> glyphs(images.size());
+			std::vector<size_t> order;
 
-			for (int u = (int)results.size() - 1; u >= 0; u--)
+			for (size_t u = 0; u < images.size(); u++)
 			{
-				if (results[u].text.size() == 1) // Imago supports only one-char-length templates
+				cv::Mat1b img;
+				try
 				{
-					_result[results[u].text[0]] = results[u].value / vars.characters.DistanceScaleFactor;
+					img = prepareImage(vars, *images[u], glyphs[u].ratio);
 				}
+				catch (ImagoException& e)
+				{
+					getLogExt().append("Exception", e.what());
+					continue;
+				}
+
+				buildGlyphMask(img, glyphs[u].mask);
+				for (int c = 0; c < 256; c++)
+				{
+					glyphs[u].best[c] = imago::DIST_INF;
+					glyphs[u].found[c] = false;
+				}
+				order.push_back(u);
+			}
+
+			if (order.empty())
+				return;
+
+			BatchRatioLess less;
+			less.glyphs = &glyphs;
+			std::sort(order.begin(), order.end(), less);
+
+			if (threads < 1)
+				threads = 1;
+			if (threads > (int)order.size())
+				threads = (int)order.size();
+
+			std::vector<BatchWorker> workers(threads);
+			for (int t = 0; t < threads; t++)
+			{
+				workers[t].index = &index;
+				workers[t].glyphs = &glyphs;
+				workers[t].first = &order[0] + order.size() * t / threads;
+				workers[t].last = &order[0] + order.size() * (t + 1) / threads;
+				workers[t].max_diff = vars.characters.RatioDiffThresh;
+				workers[t].compared = workers[t].rejected = 0;
+				workers[t].survivors = vars.characters.PyramidSurvivors;
+			}
+
+			if (threads == 1)
+			{
+				workers[0]();
+			}
+			else
+			{
+				boost::thread_group group;
+				for (int t = 0; t < threads; t++)
+					group.create_thread(boost::ref(workers[t]));
+				group.join_all();
+			}
+
+			if (getLogExt().loggingEnabled())
+			{
+				int compared = 0, rejected = 0;
+				for (int t = 0; t < threads; t++)
+				{
+					compared += workers[t].compared;
+					rejected += workers[t].rejected;
+				}
+				getLogExt().append("Templates compared", compared);
+				getLogExt().append("Templates rejected by prefilter", rejected);
 			}
 
-			return _result;
+			for (size_t u = 0; u < order.size(); u++)
+			{
+				const BatchGlyph& g = glyphs[order[u]];
+				for (int c = 0; c < RecognitionDistance::SLOTS; c++)
+				{
+					if (g.found[c])
+					{
+						results[order[u]].set((char)c, g.best[c] / vars.characters.DistanceScaleFactor);
+					}
+				}
+			}
 		}
 	}
 }
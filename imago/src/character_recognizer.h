@@ -25,6 +25,7 @@
 #include "recognition_distance.h"
 #include "segment_tools.h"
 #include "settings.h"
+#include "glyph_matching.h"
 
 namespace imago
 {
@@ -39,6 +40,10 @@ namespace imago
       RecognitionDistance recognize(const Settings& vars, const Segment &seg, 
 									const std::string &candidates = all) const;
 
+	  // recognizes all segments at once, results[i] corresponds to segs[i]
+	  void recognizeBatch(const Settings& vars, const std::vector<Segment*>& segs, 
+	                      std::vector<RecognitionDistance>& results, const std::string &candidates = all) const;
+
 	  virtual ~CharacterRecognizer() { };
 
       static const std::string upper; 
@@ -49,9 +54,6 @@ namespace imago
 	  static const std::string all;
 	  static const std::string graphics;	  
 	  static const std::string like_bonds;
-
-   private:
-	   static qword getSegmentHash(const Segment &seg);
    };
 
    namespace CharacterRecognizerImp
@@ -66,21 +68,127 @@ namespace imago
 		const int INTERNAL_ARRAY_DIM = REQUIRED_SIZE + 2*PENALTY_SHIFT;
 		const int INTERNAL_ARRAY_SIZE = INTERNAL_ARRAY_DIM * INTERNAL_ARRAY_DIM;
 
+		const int MATCH_TEXT_SIZE = 8;
+
+		// plain structure, binary font files store it as is (see font_storage.h)
 		struct MatchRecord
 		{
 			unsigned char penalty_ink[INTERNAL_ARRAY_SIZE];
 			unsigned char penalty_white[INTERNAL_ARRAY_SIZE];
-			std::string text;
 			double wh_ratio;
+			char text[MATCH_TEXT_SIZE]; // zero-terminated
+
+			// truncates value to MATCH_TEXT_SIZE - 1 chars
+			void setText(const std::string& value);
 		};
 
 		typedef std::vector<MatchRecord> Templates;
 
+		// penalty cells packed by bits for the popcount prefilter
+		const int GLYPH_BIT_WORDS = INTERNAL_ARRAY_SIZE / 64;
+
+		struct TemplateBits
+		{
+			qword ink[GLYPH_BIT_WORDS];      // cells with template ink
+			qword ink_near[GLYPH_BIT_WORDS]; // cells with rounded distance to template ink at most 1
+			qword white[GLYPH_BIT_WORDS];    // cells with template white or adding less than 1 to distance
+		};
+
+		void buildTemplateBits(const MatchRecord& mr, TemplateBits& bits);
+
+		// coarse pyramid level, each cell covers COARSE_FACTOR x COARSE_FACTOR glyph pixels
+		const int COARSE_FACTOR = 3;
+		const int COARSE_DIM = REQUIRED_SIZE / COARSE_FACTOR;
+		const int COARSE_SIZE = COARSE_DIM * COARSE_DIM;
+
+		// penalties averaged by coarse cells, the distance is approximated as
+		// base + sum of (ink pixels in cell) * ink_gain[cell]
+		struct TemplateCoarse
+		{
+			float ink_gain[COARSE_SIZE]; // average ink penalty minus average white one
+			float base;                  // distance of the completely white glyph
+		};
+
+		void buildTemplateCoarse(const MatchRecord& mr, TemplateCoarse& coarse);
+
+		// templates ordered by width/height ratio, keeps pointers to the source records
+		class TemplateIndex
+		{
+		public:
+			TemplateIndex() { }
+			TemplateIndex(const Templates& templates);
+			TemplateIndex(const MatchRecord* records, size_t count);
+
+			void addRecords(const MatchRecord* records, size_t count);
+
+			// entries are ordered by wh_ratio
+			size_t size() const { return _entries.size(); }
+			double getRatio(size_t index) const { return _entries[index].wh_ratio; }
+			const MatchRecord& getRecord(size_t index) const { return *_entries[index].record; }
+			const TemplateBits& getBits(size_t index) const { return _entries[index].bits; }
+			const TemplateCoarse& getCoarse(size_t index) const { return _entries[index].coarse; }
+
+			// bytes of the entries: ratio, record pointer and the prefilter bits and coarse levels of the record
+			size_t getMemoryUsage() const { return _entries.capacity() * sizeof(RatioEntry); }
+
+		private:
+			struct RatioEntry
+			{
+				double wh_ratio;
+				const MatchRecord* record;
+				TemplateBits bits;
+				TemplateCoarse coarse;
+				bool operator <(const RatioEntry& second) const { return wh_ratio < second.wh_ratio; }
+			};
+
+			std::vector<RatioEntry> _entries;
+		};
+
+		// penalty sums are accumulated by blocks to allow early termination
+		const int GLYPH_BLOCK_SIZE = 8 * INTERNAL_ARRAY_DIM;
+		const int GLYPH_BLOCKS = INTERNAL_ARRAY_SIZE / GLYPH_BLOCK_SIZE;
+
+		// prepared glyph pixels laid out the same way as MatchRecord penalty arrays
+		struct GlyphMask
+		{
+			unsigned char ink[INTERNAL_ARRAY_SIZE];   // 0xFF for ink pixels, 0 otherwise
+			unsigned char white[INTERNAL_ARRAY_SIZE]; // 0xFF for white pixels, 0 otherwise
+			int ink_count;
+			int white_count;
+			int ink_block_count[GLYPH_BLOCKS];
+			int white_block_count[GLYPH_BLOCKS];
+			qword ink_bits[GLYPH_BIT_WORDS];
+			qword white_bits[GLYPH_BIT_WORDS];
+			unsigned char coarse_ink[COARSE_SIZE]; // ink pixels count per coarse cell
+		};
+
+		// reference implementation, searches the nearest pixels by circles of growing radius
+		void calculatePenaltiesReference(const cv::Mat1b& img, unsigned char* penalty_ink, unsigned char* penalty_white);
+		// the same result computed by exact euclidean distance transform
 		void calculatePenalties(const cv::Mat1b& img, unsigned char* penalty_ink, unsigned char* penalty_white);
+		void buildGlyphMask(const cv::Mat1b& img, GlyphMask& mask);
+		// reference pixel-by-pixel implementation
 		double compareImages(const cv::Mat1b& img, const unsigned char* penalty_ink, const unsigned char* penalty_white);
+		// vectorized implementation, uses the best kernel available if kernel is NULL
+		double compareImages(const GlyphMask& mask, const unsigned char* penalty_ink, const unsigned char* penalty_white,
+		                     glyph_matching::MaskedSumsFunction kernel = NULL);
+		// the same as above, but returns false as soon as partial distance exceeds the bound
+		bool compareImagesBounded(const GlyphMask& mask, const unsigned char* penalty_ink, const unsigned char* penalty_white,
+		                          double bound, double& distance, glyph_matching::MaskedSumsFunction kernel = NULL);
+		// lower bound of compareImages() result, every glyph pixel missing the template pixels of
+		// the same color adds at least 1, ink pixels far from the template ink add one more
+		int lowerBoundDistance(const GlyphMask& mask, const TemplateBits& bits);
+		// approximation of compareImages() result at the coarse pyramid level
+		double coarseDistance(const GlyphMask& mask, const TemplateCoarse& coarse);
 		cv::Mat1b prepareImage(const Settings& vars, const cv::Mat1b& src, double &ratio);
 		bool initializeTemplates(const Settings& vars, const std::string& path, Templates& templates);		
 		RecognitionDistance recognizeMat(const Settings& vars, const cv::Mat1b& image, const Templates& templates);		
+		RecognitionDistance recognizeMat(const Settings& vars, const cv::Mat1b& image, const TemplateIndex& index);
+		// templates are scanned in the outer loop and the prepared images in the inner one, 
+		// images are split between 'threads' workers; if vars.characters.PyramidSurvivors is positive
+		// templates are ranked by coarseDistance() and only that many best ones are compared exactly
+		void recognizeBatch(const Settings& vars, const std::vector<const cv::Mat1b*>& images, const TemplateIndex& index,
+		                    std::vector<RecognitionDistance>& results, int threads = 1);
    };
 }
 
@@ -30,6 +30,8 @@
 #include "molecule.h"
 #include "segment.h"
 #include "segmentator.h"
+#include "segment_arena.h"
+#include "segment_index.h"
 #include "separator.h"
 #include "superatom.h"
 #include "thin_filter2.h"
@@ -57,6 +59,14 @@ double maxHeightHelper(const Settings& vars, int lines)
 	return maxHeight;
 }
 
+static bool isInsideCaption(const Settings& vars, const Segment& seg, const Rectangle& bounding)
+{
+	return seg.getX() >= bounding.x1() - vars.lab_remover.PixGapX && 
+	       seg.getX() < bounding.x2() &&
+	       seg.getY() >= bounding.y1() - vars.lab_remover.PixGapY && 
+	       seg.getY() + seg.getHeight() <= bounding.y2() + vars.lab_remover.PixGapY;
+}
+
 bool ChemicalStructureRecognizer::removeMoleculeCaptions(const Settings& vars, Image& img, SegmentDeque& symbols, SegmentDeque& graphics)
 {
 	logEnterFunction();
@@ -89,17 +99,25 @@ bool ChemicalStructureRecognizer::removeMoleculeCaptions(const Settings& vars, I
 	WeakSegmentator ws(img.getWidth(), img.getHeight());
 	ws.appendData(img, WeakSegmentator::getLookupPattern((int)vars.dynamic.CapitalHeight, false));
 
-	if (ws.SegmentPoints.size() < 2)
+	if (ws.getSegmentsCount() < 2)
 	{
 		getLogExt().appendText("Only one segment, ignoring");
 		return result;
 	}
 
-	for (WeakSegmentator::SegMap::iterator it = ws.SegmentPoints.begin(); it != ws.SegmentPoints.end(); ++it)
+	// caption candidates query the layers by area instead of scanning them
+	SegmentIndex symbols_index(img.getWidth(), img.getHeight(), 2 * borderDistance);
+	SegmentIndex graphics_index(img.getWidth(), img.getHeight(), 2 * borderDistance);
+	symbols_index.insert(symbols.begin(), symbols.end());
+	graphics_index.insert(graphics.begin(), graphics.end());
+
+	for (int id = 1; id <= ws.getSegmentsCount(); id++)
 	{
-		RectShapedBounding b(it->second);	
+		WeakSegmentator::PointsRange pts = ws.getSegmentPoints(id);
+		RectShapedBounding b(pts.first, pts.last);	
 		const Rectangle &bounding = b.getBounding();
-		getLogExt().appendPoints("segment", it->second);
+		if (getLogExt().loggingEnabled())
+			getLogExt().appendPoints("segment", Points2i(pts.first, pts.last));
 		getLogExt().append("width", bounding.width);
 		getLogExt().append("height", bounding.height);
 		if (bounding.height <= maxHeight &&
@@ -114,7 +132,8 @@ bool ChemicalStructureRecognizer::removeMoleculeCaptions(const Settings& vars, I
 			  )
 		    )
 		{
-			getLogExt().appendPoints("possibly caption", it->second);			
+			if (getLogExt().loggingEnabled())
+				getLogExt().appendPoints("possibly caption", Points2i(pts.first, pts.last));
 			
 			{
 				Rectangle badBounding = b.getBounding();
@@ -139,24 +158,22 @@ bool ChemicalStructureRecognizer::removeMoleculeCaptions(const Settings& vars, I
 					std::vector<Segment*> bad_symbols;
 					std::vector<Segment*> bad_graphics;
 
-					for (SegmentDeque::iterator it = symbols.begin(); it != symbols.end(); ++it)
-						if ((*it)->getX() >= badBounding.x1() - vars.lab_remover.PixGapX && 
-							(*it)->getX() < badBounding.x2() &&
-							(*it)->getY() >= badBounding.y1() - vars.lab_remover.PixGapY && 
-							(*it)->getY() + (*it)->getHeight() <= badBounding.y2() + vars.lab_remover.PixGapY)
-						{
-							bad_symbols.push_back(*it);
-						}
-			
-
-					for (SegmentDeque::iterator it = graphics.begin(); it != graphics.end(); ++it)
-						if ((*it)->getX() >= badBounding.x1() - vars.lab_remover.PixGapX && 
-							(*it)->getX() < badBounding.x2() &&
-							(*it)->getY() >= badBounding.y1() - vars.lab_remover.PixGapY && 
-							(*it)->getY() + (*it)->getHeight() <= badBounding.y2() + vars.lab_remover.PixGapY)
-						{
-							bad_graphics.push_back(*it);
-						}
+					// segments starting inside the bounding extended by the gaps
+					Rectangle area(badBounding.x - vars.lab_remover.PixGapX,
+					               badBounding.y - vars.lab_remover.PixGapY,
+					               badBounding.width + vars.lab_remover.PixGapX,
+					               badBounding.height + 2 * vars.lab_remover.PixGapY);
+
+					std::vector<Segment*> candidates;
+					symbols_index.queryRect(area, candidates);
+					for (size_t u = 0; u < candidates.size(); u++)
+						if (isInsideCaption(vars, *candidates[u], badBounding))
+							bad_symbols.push_back(candidates[u]);
+
+					graphics_index.queryRect(area, candidates);
+					for (size_t u = 0; u < candidates.size(); u++)
+						if (isInsideCaption(vars, *candidates[u], badBounding))
+							bad_graphics.push_back(candidates[u]);
 			
 					if (bad_symbols.size() >= bad_graphics.size())
 					{
@@ -176,18 +193,18 @@ bool ChemicalStructureRecognizer::removeMoleculeCaptions(const Settings& vars, I
 	return result;
 }
 
-void ChemicalStructureRecognizer::segmentate(const Settings& vars, Image& img, SegmentDeque& segments, bool reconnect)
+void ChemicalStructureRecognizer::segmentate(const Settings& vars, Image& img, SegmentArena& arena, SegmentDeque& segments, bool reconnect)
 {
 	logEnterFunction();
 
 	// extract segments using WeakSegmentator
 	WeakSegmentator ws(img.getWidth(), img.getHeight());
 	ws.appendData(img, WeakSegmentator::getLookupPattern(vars.csr.WeakSegmentatorDist), reconnect);
-	for (WeakSegmentator::SegMap::iterator it = ws.SegmentPoints.begin(); it != ws.SegmentPoints.end(); ++it)
+	for (int id = 1; id <= ws.getSegmentsCount(); id++)
 	{
-		const Points2i& pts = it->second;
-		RectShapedBounding b(pts);
-		Segment *s = new Segment();		
+		WeakSegmentator::PointsRange pts = ws.getSegmentPoints(id);
+		RectShapedBounding b(pts.first, pts.last);
+		Segment *s = arena.create();
 		s->init(b.getBounding().width+1, b.getBounding().height+1);
 		s->fillWhite();
 		s->getX() = b.getBounding().x;
@@ -267,7 +284,7 @@ bool ChemicalStructureRecognizer::isReconnectSegmentsRequired(const Settings& va
 
 	for (size_t u = 0; u < segments.size(); u++)
 	{
-		int count = SegmentTools::getAllFilled((*segments[u])).size();
+		int count = SegmentTools::getFilledCount(*segments[u]);
 		avg_fill += count;
 		if (count < vars.prefilterCV.MinGoodPixelsCount / 2)
 			surely_bad++;
@@ -294,45 +311,12 @@ bool ChemicalStructureRecognizer::isReconnectSegmentsRequired(const Settings& va
 	return result;
 }
 
-void ClearSegments(SegmentDeque& segs, SegmentDeque& segSymbols, SegmentDeque& segGraphics)
+static void releaseSegments(SegmentArena& arena, SegmentDeque& segs, SegmentDeque& segSymbols, SegmentDeque& segGraphics)
 {
-	std::map<std::string, Segment*> all_segs;
-	std::map<std::string, Segment*>::iterator map_it;
-	SegmentDeque::iterator it;
-
-	for(it = segs.begin(); it != segs.end(); ++it)
-	{
-		std::ostringstream str;
-		str << (*it);
-		all_segs[str.str()] = (*it);
-	}
-
-	for(it = segSymbols.begin(); it != segSymbols.end(); ++it)
-	{
-		std::ostringstream str;
-		str << (*it);
-		if(all_segs.find(str.str()) == all_segs.end())
-			all_segs[str.str()] = (*it);
-	}
-
-	for(it = segGraphics.begin(); it != segGraphics.end(); ++it)
-	{
-		std::ostringstream str;
-		str << (*it);
-		if(all_segs.find(str.str()) == all_segs.end())
-			all_segs[str.str()] = (*it);
-	}
-
-	for(map_it = all_segs.begin(); map_it != all_segs.end(); ++map_it)
-	{
-		if((*map_it).second)
-			delete (*map_it).second;
-	}
-
 	segGraphics.clear();
 	segSymbols.clear();
 	segs.clear();
-	all_segs.clear();
+	arena.reset();
 }
 
 void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol) 
@@ -346,6 +330,8 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 	restart:
 
 	{
+		// owns every segment of this pass, released on restart, exit or exception
+		SegmentArena arena;
 		SegmentDeque segments;
 		SegmentDeque layer_symbols, layer_graphics;
 
@@ -369,7 +355,7 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 	  
 			getLogExt().appendImage("Cropped image", _img);		
 		
-			segmentate(vars, _img, segments);
+			segmentate(vars, _img, arena, segments);
 		
 			bool reconnect = isReconnectSegmentsRequired(vars, _img, segments);
 			if (reconnect)
@@ -382,15 +368,11 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 				prefilter_basic::prefilterBasicFullsize(vars, temp_img);
 
 				SegmentDeque temp;
-				segmentate(vars, temp_img, temp);
+				segmentate(vars, temp_img, arena, temp);
 
+				// segments replaced are released with the arena
 				if (temp.size() > 0)
-				{
-					SegmentDeque temp1, temp2;
-					ClearSegments(segments, temp1, temp2);
-
-					segments = temp;
-				}			
+					segments = temp;			
 			}
 
 			if (vars.checkTimeLimit())
@@ -410,7 +392,7 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 			if (vars.checkTimeLimit())
 				throw ImagoException("Timelimit exceeded");
 	  
-			Separator sep(segments, _img);
+			Separator sep(segments, _img, arena);
 		
 			sep.Separate(vars, _cr, layer_symbols, layer_graphics);
 
@@ -426,7 +408,7 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 				{
 					captions_removed = true;					
 					getLogExt().appendText("Restart after molecule captions cleanup");
-					ClearSegments(segments, layer_symbols, layer_graphics);
+					releaseSegments(arena, segments, layer_symbols, layer_graphics);
 					// looks like performance degrade, but actually gives more accurate result (due to capital height re-estimation) at a almost zero-cost in terms of cpu time
 					goto restart;
 				}
@@ -581,13 +563,21 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 			if (vars.checkTimeLimit())
 				throw ImagoException("Timelimit exceeded");
 
-			ClearSegments(segments, layer_symbols, layer_graphics);
+			if (getLogExt().loggingEnabled())
+			{
+				int computed, reused;
+				arena.getFeatureStats(computed, reused);
+				getLogExt().append("Segment features computed", computed);
+				getLogExt().append("Segment features reused", reused);
+			}
+
+			releaseSegments(arena, segments, layer_symbols, layer_graphics);
 
 			getLogExt().appendText("Recognition finished");
 		}
 		catch (ImagoException&)
 		{
-			ClearSegments(segments, layer_symbols, layer_graphics);
+			releaseSegments(arena, segments, layer_symbols, layer_graphics);
 			throw;
 		}
 	}
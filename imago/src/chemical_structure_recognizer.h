@@ -26,6 +26,7 @@ namespace imago
    class Molecule;
    class Segment;
    class CharacterRecognizer;
+   class SegmentArena;
    
    class ChemicalStructureRecognizer
    {
@@ -45,7 +46,7 @@ namespace imago
       Image _origImage;
 
 	  bool removeMoleculeCaptions(const Settings& vars, Image& img, SegmentDeque& layer_symbols, SegmentDeque& layer_graphics);
-	  void segmentate(const Settings& vars, Image& img, SegmentDeque& segments, bool connect_mode = false);
+	  void segmentate(const Settings& vars, Image& img, SegmentArena& arena, SegmentDeque& segments, bool connect_mode = false);
 	  void storeSegments(const Settings& vars, SegmentDeque& layer_symbols, SegmentDeque& layer_graphics);
 	  bool isReconnectSegmentsRequired(const Settings& vars, const Image& img, const SegmentDeque& segments);
       
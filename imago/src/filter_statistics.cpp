@@ -0,0 +1,196 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "filter_statistics.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <boost/thread/once.hpp>
+#include "exception.h"
+
+namespace imago
+{
+	static FilterStatistics* sharedInstance = NULL;
+	static boost::once_flag sharedOnce = BOOST_ONCE_INIT;
+
+	static void createShared()
+	{
+		// never destroyed: sessions may still use it during static destruction
+		sharedInstance = new FilterStatistics();
+	}
+
+	FilterStatistics& FilterStatistics::getShared()
+	{
+		boost::call_once(createShared, sharedOnce);
+		return *sharedInstance;
+	}
+
+	struct OrderItem
+	{
+		int index;
+		double score;
+	};
+
+	static bool betterScore(const OrderItem& a, const OrderItem& b)
+	{
+		return a.score > b.score;
+	}
+
+	void FilterStatistics::getOrder(const std::string& image_class, const FilterEntries& filters, std::vector<int>& order) const
+	{
+		lock_guard lock(_mutex);
+
+		order.clear();
+		std::vector<OrderItem> learned;
+		std::vector<int> never_good;
+
+		for (size_t u = 0; u < filters.size(); u++)
+		{
+			Records::const_iterator it = _records.find(std::make_pair(image_class, filters[u].name));
+			if (it == _records.end() || it->second.attempts < MIN_SAMPLES)
+			{
+				order.push_back((int)u);
+			}
+			else if (it->second.good == 0)
+			{
+				never_good.push_back((int)u);
+			}
+			else
+			{
+				const FilterRecord& r = it->second;
+				OrderItem item;
+				item.index = (int)u;
+				item.score = (double)r.good / r.attempts / std::max(1.0, (r.filter_ms + r.recognition_ms) / r.attempts);
+				learned.push_back(item);
+			}
+		}
+
+		std::stable_sort(learned.begin(), learned.end(), betterScore);
+		for (size_t u = 0; u < learned.size(); u++)
+			order.push_back(learned[u].index);
+
+		// still tried when all the others fail: their attempts only come from such images,
+		// so the records keep updating and may recover
+		order.insert(order.end(), never_good.begin(), never_good.end());
+	}
+
+	void FilterStatistics::recordFilter(const std::string& image_class, const std::string& filter, bool applied, double ms)
+	{
+		lock_guard lock(_mutex);
+		if (_frozen)
+			return;
+
+		FilterRecord& r = _records[std::make_pair(image_class, filter)];
+		r.attempts++;
+		if (applied)
+			r.applied++;
+		r.filter_ms += ms;
+
+		if (r.attempts >= MAX_SAMPLES)
+		{
+			r.attempts /= 2;
+			r.applied /= 2;
+			r.good /= 2;
+			r.filter_ms /= 2.0;
+			r.recognition_ms /= 2.0;
+		}
+	}
+
+	void FilterStatistics::recordRecognition(const std::string& image_class, const std::string& filter, bool good, double ms)
+	{
+		lock_guard lock(_mutex);
+		if (_frozen)
+			return;
+
+		FilterRecord& r = _records[std::make_pair(image_class, filter)];
+		if (good)
+			r.good++;
+		r.recognition_ms += ms;
+	}
+
+	FilterRecord FilterStatistics::getRecord(const std::string& image_class, const std::string& filter) const
+	{
+		lock_guard lock(_mutex);
+		Records::const_iterator it = _records.find(std::make_pair(image_class, filter));
+		return it == _records.end() ? FilterRecord() : it->second;
+	}
+
+	void FilterStatistics::setFrozen(bool frozen)
+	{
+		lock_guard lock(_mutex);
+		_frozen = frozen;
+	}
+
+	bool FilterStatistics::isFrozen() const
+	{
+		lock_guard lock(_mutex);
+		return _frozen;
+	}
+
+	void FilterStatistics::clear()
+	{
+		lock_guard lock(_mutex);
+		_records.clear();
+	}
+
+	bool FilterStatistics::load(const std::string& filename)
+	{
+		std::ifstream in(filename.c_str());
+		if (!in)
+			return false;
+
+		lock_guard lock(_mutex);
+
+		std::string line;
+		while (std::getline(in, line))
+		{
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			std::istringstream fields(line);
+			std::string image_class, filter;
+			FilterRecord r;
+			if (!(fields >> image_class >> filter >> r.attempts >> r.applied >> r.good >> r.filter_ms >> r.recognition_ms))
+				throw ImagoException("Invalid filter statistics line: " + line);
+
+			FilterRecord& sum = _records[std::make_pair(image_class, filter)];
+			sum.attempts += r.attempts;
+			sum.applied += r.applied;
+			sum.good += r.good;
+			sum.filter_ms += r.filter_ms;
+			sum.recognition_ms += r.recognition_ms;
+		}
+
+		return true;
+	}
+
+	void FilterStatistics::save(const std::string& filename) const
+	{
+		std::ofstream out(filename.c_str());
+		if (!out)
+			throw ImagoException("Can not write filter statistics file " + filename);
+
+		lock_guard lock(_mutex);
+
+		out << "# image_class filter attempts applied good filter_ms recognition_ms" << std::endl;
+		out << std::fixed << std::setprecision(1);
+		for (Records::const_iterator it = _records.begin(); it != _records.end(); ++it)
+		{
+			const FilterRecord& r = it->second;
+			out << it->first.first << " " << it->first.second << " " << r.attempts << " " << r.applied << " " 
+				<< r.good << " " << r.filter_ms << " " << r.recognition_ms << std::endl;
+		}
+	}
+}
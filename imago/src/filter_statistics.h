@@ -0,0 +1,88 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _filter_statistics_h
+#define _filter_statistics_h
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include "filters_list.h"
+
+namespace imago
+{
+	struct FilterRecord
+	{
+		int attempts; // filter routine called
+		int applied;  // routine accepted the image
+		int good;     // recognition of the filtered image gave a good result
+		double filter_ms;
+		double recognition_ms;
+
+		FilterRecord() : attempts(0), applied(0), good(0), filter_ms(0.0), recognition_ms(0.0) {}
+	};
+
+	// outcomes of the prefilters per image class, orders the chain to try first the filters giving 
+	// a good result in the least time for the class; safe for concurrent sessions
+	class FilterStatistics
+	{
+	public:
+		// attempts of a filter required before its position in the class order is learned
+		static const int MIN_SAMPLES = 8;
+
+		// attempts at which the counters of a record are halved, so old outcomes fade out and
+		// a filter giving no good results on the earlier image mix can recover
+		static const int MAX_SAMPLES = 64;
+
+		FilterStatistics() : _frozen(false) {}
+
+		// process-wide instance used by Settings by default
+		static FilterStatistics& getShared();
+
+		// filters list indexes to try: filters lacking samples first in the fixed order, then by
+		// good results per millisecond; filters never giving a good result are the last resort
+		void getOrder(const std::string& image_class, const FilterEntries& filters, std::vector<int>& order) const;
+
+		void recordFilter(const std::string& image_class, const std::string& filter, bool applied, double ms);
+		void recordRecognition(const std::string& image_class, const std::string& filter, bool good, double ms);
+
+		FilterRecord getRecord(const std::string& image_class, const std::string& filter) const;
+
+		// records are not changed while frozen, for reproducible runs
+		void setFrozen(bool frozen);
+		bool isFrozen() const;
+
+		void clear();
+
+		// text file with a line per class and filter; load adds the records, returns false if there is no file
+		bool load(const std::string& filename);
+		void save(const std::string& filename) const;
+
+	private:
+		typedef std::map<std::pair<std::string, std::string>, FilterRecord> Records;
+		typedef boost::lock_guard<boost::mutex> lock_guard;
+
+		Records _records;
+		bool _frozen;
+		mutable boost::mutex _mutex;
+
+		FilterStatistics(const FilterStatistics&);
+		FilterStatistics& operator=(const FilterStatistics&);
+	};
+}
+
+#endif // _filter_statistics_h
@@ -18,13 +18,14 @@
 
 namespace imago
 {
-	FilterEntryDefinition::FilterEntryDefinition(const std::string& _name, int _priority, FilterFunction _f, const std::string& _config, ConditionFunction _c)
+	FilterEntryDefinition::FilterEntryDefinition(const std::string& _name, int _priority, FilterFunction _f, const std::string& _config, ConditionFunction _c, bool _estimations)
 	{
 		name = _name;
 		priority = _priority;
 		routine = _f;
 		condition = _c;
 		update_config_string = _config;
+		uses_estimations = _estimations;
 	}
 
 	FilterEntries::FilterEntries()
@@ -34,7 +35,8 @@ namespace imago
 
 		push_back(FilterEntryDefinition("prefilter_retinex",   2,   prefilter_retinex::prefilterRetinexDownscaleOnly));		
 
-		push_back(FilterEntryDefinition("prefilter_basic_s",   3,   prefilter_basic::prefilterBasicForceDownscale));
+		push_back(FilterEntryDefinition("prefilter_basic_s",   3,   prefilter_basic::prefilterBasicForceDownscale, 
+			                            "", NULL, true));
 
 		push_back(FilterEntryDefinition("prefilter_basic",     4,   prefilter_basic::prefilterBasicFullsize));
 	}
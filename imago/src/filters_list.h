@@ -20,22 +20,24 @@
 #include <vector>
 #include "image.h"
 #include "settings.h"
+#include "prefilter_context.h"
 
 namespace imago
 {
 	struct FilterEntryDefinition
 	{
 		typedef bool(*ConditionFunction)(const Image&);
-		typedef bool(*FilterFunction)(Settings&, Image&);
+		typedef bool(*FilterFunction)(Settings&, PrefilterContext&, Image&);
 
 		std::string name;
 		std::string update_config_string;
 		int priority;
 		ConditionFunction condition;
 		FilterFunction routine;
+		bool uses_estimations; // routine reads vars.dynamic left by the recognition of the previous filter
 		
 		FilterEntryDefinition(const std::string& _name, int _priority, FilterFunction _f, 
-			                  const std::string& _config = "", ConditionFunction _c = NULL);
+			                  const std::string& _config = "", ConditionFunction _c = NULL, bool _estimations = false);
 	};
 
 	class FilterEntries : public std::vector<FilterEntryDefinition>
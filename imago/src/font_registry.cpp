@@ -0,0 +1,106 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "font_registry.h"
+#include <boost/thread/once.hpp>
+#include "log_ext.h"
+
+namespace imago
+{
+	namespace CharacterRecognizerImp
+	{
+		// created once and never destroyed, so mapped fonts stay valid until the process exits
+		static FontRegistry* registryInstance = NULL;
+		static boost::once_flag registryOnce = BOOST_ONCE_INIT;
+
+		void FontRegistry::create()
+		{
+			registryInstance = new FontRegistry();
+		}
+
+		FontRegistry& FontRegistry::getInstance()
+		{
+			boost::call_once(&FontRegistry::create, registryOnce);
+			return *registryInstance;
+		}
+
+		FontRegistry::FontRegistry()
+		{
+			_index.reset(new TemplateIndex());
+
+			boost::shared_ptr<FontStorage> font(new FontStorage());
+			font->loadDefault();
+			appendFont(font);
+		}
+
+		void FontRegistry::appendFont(const boost::shared_ptr<FontStorage>& font)
+		{
+			lock_guard lock(_mutex);
+
+			// sessions keep using the previous snapshot until they request the index again
+			TemplateIndex* index = new TemplateIndex(*_index);
+			index->addRecords(font->getRecords(), font->getCount());
+
+			_fonts.push_back(font);
+			_index.reset(index);
+		}
+
+		void FontRegistry::registerFontFile(const std::string& filename)
+		{
+			boost::shared_ptr<FontStorage> font(new FontStorage());
+			font->loadFile(filename);
+			appendFont(font);
+			getLogExt().append("Registered font file", filename);
+		}
+
+		void FontRegistry::registerTemplates(const Templates& templates)
+		{
+			boost::shared_ptr<FontStorage> font(new FontStorage());
+			font->assign(templates);
+			appendFont(font);
+		}
+
+		boost::shared_ptr<const TemplateIndex> FontRegistry::getIndex() const
+		{
+			lock_guard lock(_mutex);
+			return _index;
+		}
+
+		size_t FontRegistry::getFontsCount() const
+		{
+			lock_guard lock(_mutex);
+			return _fonts.size();
+		}
+
+		size_t FontRegistry::getTemplatesCount() const
+		{
+			lock_guard lock(_mutex);
+			size_t result = 0;
+			for (size_t u = 0; u < _fonts.size(); u++)
+				result += _fonts[u]->getCount();
+			return result;
+		}
+
+		size_t FontRegistry::getHeapUsage() const
+		{
+			lock_guard lock(_mutex);
+			size_t result = 0;
+			for (size_t u = 0; u < _fonts.size(); u++)
+				result += _fonts[u]->getOwnedSize();
+			// index entries keep the prefilter bits and coarse levels next to the record pointer
+			result += _index->getMemoryUsage();
+			return result;
+		}
+	}
+}
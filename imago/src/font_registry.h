@@ -0,0 +1,69 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _font_registry_h
+#define _font_registry_h
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include "character_recognizer.h"
+#include "font_storage.h"
+
+namespace imago
+{
+	namespace CharacterRecognizerImp
+	{
+		// process-wide read-only font templates shared by all sessions and threads
+		class FontRegistry
+		{
+		public:
+			// the default font is loaded on the first call
+			static FontRegistry& getInstance();
+
+			// adds templates from the binary font file, throws ImagoException if it is not valid
+			void registerFontFile(const std::string& filename);
+
+			// adds own copy of the specified templates
+			void registerTemplates(const Templates& templates);
+
+			// current index snapshot, registered fonts are never released
+			boost::shared_ptr<const TemplateIndex> getIndex() const;
+
+			size_t getFontsCount() const;
+			size_t getTemplatesCount() const;
+
+			// heap memory occupied by the template copies and index entries
+			size_t getHeapUsage() const;
+
+		private:
+			FontRegistry();
+			FontRegistry(const FontRegistry&);
+			static void create();
+			FontRegistry& operator=(const FontRegistry&);
+
+			void appendFont(const boost::shared_ptr<FontStorage>& font);
+
+			typedef boost::lock_guard<boost::mutex> lock_guard;
+			mutable boost::mutex _mutex;
+			std::vector<boost::shared_ptr<FontStorage> > _fonts;
+			boost::shared_ptr<const TemplateIndex> _index;
+		};
+	}
+}
+
+#endif // _font_registry_h
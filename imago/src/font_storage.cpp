@@ -0,0 +1,199 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "font_storage.h"
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <string.h>
+#include "exception.h"
+#include "platform_tools.h"
+#include "log_ext.h"
+
+namespace imago
+{
+	namespace CharacterRecognizerImp
+	{
+		static const char FONT_SIGNATURE[8] = { 'I', 'M', 'A', 'G', 'O', 'F', 'N', 'T' };
+
+		static const qword EmbeddedFontData[] = 
+		{
+			#include "font_data.inc"
+		};
+
+		FontStorage::FontStorage()
+		{
+			_mapped = NULL;
+			_mapped_size = 0;
+			_records = NULL;
+			_count = 0;
+		}
+
+		FontStorage::~FontStorage()
+		{
+			release();
+		}
+
+		void FontStorage::release()
+		{
+			if (_mapped != NULL)
+			{
+				platform::MEMORY_UNMAP_FILE(_mapped, _mapped_size);
+				_mapped = NULL;
+				_mapped_size = 0;
+			}
+			_owned.clear();
+			_records = NULL;
+			_count = 0;
+		}
+
+		void FontStorage::assign(const Templates& templates)
+		{
+			release();
+			_owned = templates;
+			_records = _owned.empty() ? NULL : &_owned[0];
+			_count = _owned.size();
+		}
+
+		void FontStorage::attach(const void* data, size_t size)
+		{
+			FontFileHeader header;
+			if (size < sizeof(header))
+				throw ImagoException("Font data is too short");
+			memcpy(&header, data, sizeof(header));
+
+			if (memcmp(header.signature, FONT_SIGNATURE, sizeof(FONT_SIGNATURE)) != 0)
+				throw ImagoException("Font data signature mismatch");
+			if (header.byte_order != FONT_BYTE_ORDER_MARK)
+				throw ImagoException("Font data byte order is not supported");
+			if (header.version != FONT_FILE_VERSION)
+				throw ImagoException("Font data version " + ImagoException::str(header.version) + " is not supported");
+			if (header.record_size != sizeof(MatchRecord))
+				throw ImagoException("Font record size mismatch");
+			if (header.data_offset % FONT_DATA_ALIGNMENT != 0 || header.data_offset < sizeof(header) ||
+				header.data_offset + (size_t)header.record_count * header.record_size > size)
+				throw ImagoException("Font data is corrupted");
+
+			const char* records = (const char*)data + header.data_offset;
+			if ((size_t)records % sizeof(double) != 0)
+				throw ImagoException("Font data is not aligned");
+
+			_records = (const MatchRecord*)records;
+			_count = header.record_count;
+		}
+
+		void FontStorage::loadFile(const std::string& filename)
+		{
+			release();
+
+			size_t size = 0;
+			const void* data = platform::MEMORY_MAP_FILE(filename, size);
+			if (data == NULL)
+				throw ImagoException("Can not map font file " + filename);
+
+			_mapped = data;
+			_mapped_size = size;
+
+			try
+			{
+				attach(data, size);
+			}
+			catch (ImagoException&)
+			{
+				release();
+				throw;
+			}
+		}
+
+		void FontStorage::loadEmbedded()
+		{
+			release();
+			attach(EmbeddedFontData, sizeof(EmbeddedFontData));
+		}
+
+		void FontStorage::loadDefault()
+		{
+			const char* filename = getenv("IMAGO_FONT_FILE");
+			if (filename != NULL && filename[0] != 0)
+			{
+				try
+				{
+					loadFile(filename);
+					return;
+				}
+				catch (ImagoException& e)
+				{
+					getLogExt().append("Font file is skipped", e.what());
+				}
+			}
+			loadEmbedded();
+		}
+
+		static std::string buildImage(const Templates& templates)
+		{
+			FontFileHeader header;
+			memset(&header, 0, sizeof(header));
+			memcpy(header.signature, FONT_SIGNATURE, sizeof(FONT_SIGNATURE));
+			header.version = FONT_FILE_VERSION;
+			header.byte_order = FONT_BYTE_ORDER_MARK;
+			header.record_size = sizeof(MatchRecord);
+			header.record_count = (unsigned int)templates.size();
+			header.data_offset = ((sizeof(header) + FONT_DATA_ALIGNMENT - 1) / FONT_DATA_ALIGNMENT) * FONT_DATA_ALIGNMENT;
+
+			std::string image(header.data_offset + templates.size() * sizeof(MatchRecord), '\0');
+			memcpy(&image[0], &header, sizeof(header));
+			for (size_t u = 0; u < templates.size(); u++)
+				memcpy(&image[header.data_offset + u * sizeof(MatchRecord)], &templates[u], sizeof(MatchRecord));
+
+			// embedded data is stored by 64-bit words
+			image.resize(((image.size() + sizeof(qword) - 1) / sizeof(qword)) * sizeof(qword), '\0');
+			return image;
+		}
+
+		void FontStorage::saveFile(const std::string& filename, const Templates& templates)
+		{
+			std::string image = buildImage(templates);
+
+			std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+			if (!out)
+				throw ImagoException("Can not write font file " + filename);
+			out.write(image.data(), image.size());
+		}
+
+		void FontStorage::saveEmbeddedSource(const std::string& filename, const Templates& templates)
+		{
+			std::string image = buildImage(templates);
+
+			FILE* f = fopen(filename.c_str(), "w");
+			if (f == NULL)
+				throw ImagoException("Can not write font source " + filename);
+
+			fprintf(f, "// Imago font data (%u templates), generated by imago_console -makefont\n", (unsigned int)templates.size());
+
+			const size_t words = image.size() / sizeof(qword);
+			for (size_t u = 0; u < words; u++)
+			{
+				// little-endian words, as the data is laid out on supported platforms
+				qword value = 0;
+				for (int b = (int)sizeof(qword) - 1; b >= 0; b--)
+					value = (value << 8) | (unsigned char)image[u * sizeof(qword) + b];
+
+				fprintf(f, "0x%08x%08xULL,%c", (unsigned int)(value >> 32), (unsigned int)(value & 0xFFFFFFFF), 
+					(u % 4 == 3 || u + 1 == words) ? '\n' : ' ');
+			}
+
+			fclose(f);
+		}
+	}
+}
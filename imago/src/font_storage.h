@@ -0,0 +1,93 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _font_storage_h
+#define _font_storage_h
+
+#include <string>
+#include "character_recognizer.h"
+
+namespace imago
+{
+	namespace CharacterRecognizerImp
+	{
+		const unsigned int FONT_FILE_VERSION = 1;
+		const unsigned int FONT_BYTE_ORDER_MARK = 0x01020304;
+		const unsigned int FONT_DATA_ALIGNMENT = 64;
+
+		// binary font file starts with this header, record_count MatchRecord structures follow
+		// from data_offset; numbers are stored in the byte order of the producer
+		struct FontFileHeader
+		{
+			char signature[8];        // "IMAGOFNT"
+			unsigned int version;     // FONT_FILE_VERSION
+			unsigned int byte_order;  // FONT_BYTE_ORDER_MARK
+			unsigned int record_size; // sizeof(MatchRecord)
+			unsigned int record_count;
+			unsigned int data_offset; // multiple of FONT_DATA_ALIGNMENT
+			unsigned int reserved[9];
+		};
+
+		// read-only font templates, used in place from the mapped file or the embedded data
+		class FontStorage
+		{
+		public:
+			FontStorage();
+			~FontStorage();
+
+			// maps binary font file, throws ImagoException if it is not valid
+			void loadFile(const std::string& filename);
+
+			// uses the font compiled into the library (font_data.inc)
+			void loadEmbedded();
+
+			// uses the file from IMAGO_FONT_FILE environment variable if specified, embedded font otherwise
+			void loadDefault();
+
+			// keeps own copy of the specified templates
+			void assign(const Templates& templates);
+
+			// true if records are located in the mapped file
+			bool isMapped() const { return _mapped != NULL; }
+
+			// heap memory occupied by own copy of records
+			size_t getOwnedSize() const { return _owned.size() * sizeof(MatchRecord); }
+
+			const MatchRecord* getRecords() const { return _records; }
+			size_t getCount() const { return _count; }
+
+			// writes templates in the binary font file format
+			static void saveFile(const std::string& filename, const Templates& templates);
+
+			// writes templates as C++ include with the embedded font data
+			static void saveEmbeddedSource(const std::string& filename, const Templates& templates);
+
+		private:
+			FontStorage(const FontStorage&);
+			FontStorage& operator=(const FontStorage&);
+
+			void attach(const void* data, size_t size);
+			void release();
+
+			const void* _mapped;
+			size_t _mapped_size;
+			Templates _owned;
+			const MatchRecord* _records;
+			size_t _count;
+		};
+	}
+}
+
+#endif // _font_storage_h
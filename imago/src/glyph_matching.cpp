@@ -0,0 +1,115 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include <cstddef>
+#include "glyph_matching.h"
+#include "platform_tools.h"
+
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGO_GLYPH_MATCHING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace imago
+{
+	namespace glyph_matching
+	{
+		static void maskedSumsScalar(const unsigned char* ink_mask, const unsigned char* white_mask,
+		                             const unsigned char* penalty_ink, const unsigned char* penalty_white,
+		                             int size, int& sum_ink, int& sum_white)
+		{
+			int ink = 0, white = 0;
+			for (int u = 0; u < size; u++)
+			{
+				ink += ink_mask[u] & penalty_ink[u];
+				white += white_mask[u] & penalty_white[u];
+			}
+			sum_ink = ink;
+			sum_white = white;
+		}
+
+#ifdef IMAGO_GLYPH_MATCHING_SSE2
+		static void maskedSumsSSE2(const unsigned char* ink_mask, const unsigned char* white_mask,
+		                           const unsigned char* penalty_ink, const unsigned char* penalty_white,
+		                           int size, int& sum_ink, int& sum_white)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			__m128i acc_ink = _mm_setzero_si128();
+			__m128i acc_white = _mm_setzero_si128();
+
+			for (int u = 0; u < size; u += 16)
+			{
+				__m128i ink = _mm_and_si128(_mm_loadu_si128((const __m128i*)(ink_mask + u)),
+				                            _mm_loadu_si128((const __m128i*)(penalty_ink + u)));
+				__m128i white = _mm_and_si128(_mm_loadu_si128((const __m128i*)(white_mask + u)),
+				                              _mm_loadu_si128((const __m128i*)(penalty_white + u)));
+				// horizontal byte sums into two 64-bit lanes
+				acc_ink = _mm_add_epi64(acc_ink, _mm_sad_epu8(ink, zero));
+				acc_white = _mm_add_epi64(acc_white, _mm_sad_epu8(white, zero));
+			}
+
+			sum_ink = _mm_cvtsi128_si32(acc_ink) + _mm_cvtsi128_si32(_mm_srli_si128(acc_ink, 8));
+			sum_white = _mm_cvtsi128_si32(acc_white) + _mm_cvtsi128_si32(_mm_srli_si128(acc_white, 8));
+		}
+#endif
+
+		MaskedSumsFunction getMaskedSumsKernel(int level)
+		{
+			switch (level)
+			{
+			case klScalar:
+				return maskedSumsScalar;
+#ifdef IMAGO_GLYPH_MATCHING_SSE2
+			case klSSE2:
+				if (platform::CPU_FEATURES() & platform::cfSSE2)
+					return maskedSumsSSE2;
+				break;
+#endif
+			case klAVX2:
+				if (platform::CPU_FEATURES() & platform::cfAVX2)
+					return getAvx2MaskedSums();
+				break;
+			}
+			return NULL;
+		}
+
+		static MaskedSumsFunction selectBestKernel()
+		{
+			for (int level = klCount - 1; level > klScalar; level--)
+			{
+				MaskedSumsFunction f = getMaskedSumsKernel(level);
+				if (f != NULL)
+					return f;
+			}
+			return maskedSumsScalar;
+		}
+
+		MaskedSumsFunction getBestMaskedSumsKernel()
+		{
+			static MaskedSumsFunction best = selectBestKernel();
+			return best;
+		}
+
+		const char* getKernelLevelName(int level)
+		{
+			switch (level)
+			{
+			case klScalar: return "scalar";
+			case klSSE2:   return "sse2";
+			case klAVX2:   return "avx2";
+			}
+			return "unknown";
+		}
+	}
+}
@@ -0,0 +1,67 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _glyph_matching_h
+#define _glyph_matching_h
+
+// NOTE: this header is included by translation units compiled with extended
+// instruction set flags, so it should not pull any STL or OpenCV headers.
+
+namespace imago
+{
+	namespace glyph_matching
+	{
+		// accumulates sum(ink_mask & penalty_ink) and sum(white_mask & penalty_white),
+		// 'size' should be a multiple of 32
+		typedef void (*MaskedSumsFunction)(const unsigned char* ink_mask, const unsigned char* white_mask,
+		                                   const unsigned char* penalty_ink, const unsigned char* penalty_white,
+		                                   int size, int& sum_ink, int& sum_white);
+
+		enum KernelLevel
+		{
+			klScalar = 0,
+			klSSE2,
+			klAVX2,
+			klCount
+		};
+
+		// returns kernel for specified level or NULL if it is not supported by the CPU or compiler
+		MaskedSumsFunction getMaskedSumsKernel(int level);
+
+		// returns the fastest kernel supported, selected once
+		MaskedSumsFunction getBestMaskedSumsKernel();
+
+		// returns printable name of the kernel level
+		const char* getKernelLevelName(int level);
+
+		// implemented in glyph_matching_avx2.cpp, returns NULL if compiled without AVX2 support
+		MaskedSumsFunction getAvx2MaskedSums();
+
+		// count of bits set
+		inline int popcount(unsigned long long value)
+		{
+#if defined(__GNUC__)
+			return __builtin_popcountll(value);
+#else
+			value = value - ((value >> 1) & 0x5555555555555555ULL);
+			value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+			value = (value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+			return (int)((value * 0x0101010101010101ULL) >> 56);
+#endif
+		}
+	}
+}
+
+#endif // _glyph_matching_h
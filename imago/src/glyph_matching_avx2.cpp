@@ -0,0 +1,65 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+// This file is compiled with AVX2 code generation enabled (see imago/CMakeLists.txt),
+// the kernel is called only if platform::CPU_FEATURES() reports AVX2 support.
+
+#include "glyph_matching.h"
+
+#if defined(__AVX2__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+#define IMAGO_GLYPH_MATCHING_AVX2
+#include <immintrin.h>
+#endif
+
+namespace imago
+{
+	namespace glyph_matching
+	{
+#ifdef IMAGO_GLYPH_MATCHING_AVX2
+		static void maskedSumsAVX2(const unsigned char* ink_mask, const unsigned char* white_mask,
+		                           const unsigned char* penalty_ink, const unsigned char* penalty_white,
+		                           int size, int& sum_ink, int& sum_white)
+		{
+			const __m256i zero = _mm256_setzero_si256();
+			__m256i acc_ink = _mm256_setzero_si256();
+			__m256i acc_white = _mm256_setzero_si256();
+
+			for (int u = 0; u < size; u += 32)
+			{
+				__m256i ink = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(ink_mask + u)),
+				                               _mm256_loadu_si256((const __m256i*)(penalty_ink + u)));
+				__m256i white = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(white_mask + u)),
+				                                 _mm256_loadu_si256((const __m256i*)(penalty_white + u)));
+				acc_ink = _mm256_add_epi64(acc_ink, _mm256_sad_epu8(ink, zero));
+				acc_white = _mm256_add_epi64(acc_white, _mm256_sad_epu8(white, zero));
+			}
+
+			// fold four 64-bit lanes, each partial sum fits into 32 bits
+			__m128i ink = _mm_add_epi64(_mm256_castsi256_si128(acc_ink), _mm256_extracti128_si256(acc_ink, 1));
+			__m128i white = _mm_add_epi64(_mm256_castsi256_si128(acc_white), _mm256_extracti128_si256(acc_white, 1));
+			sum_ink = _mm_cvtsi128_si32(ink) + _mm_cvtsi128_si32(_mm_srli_si128(ink, 8));
+			sum_white = _mm_cvtsi128_si32(white) + _mm_cvtsi128_si32(_mm_srli_si128(white, 8));
+		}
+#endif
+
+		MaskedSumsFunction getAvx2MaskedSums()
+		{
+#ifdef IMAGO_GLYPH_MATCHING_AVX2
+			return maskedSumsAVX2;
+#else
+			return 0;
+#endif
+		}
+	}
+}
@@ -15,12 +15,14 @@
 #include <cmath>
 #include <deque>
 #include <vector>
+#include <map>
 
 #include "boost/foreach.hpp"
 
 #include "graphics_detector.h"
 #include "image.h"
 #include "segment.h"
+#include "segment_runs.h"
 #include "segmentator.h"
 #include "approximator.h"
 #include "thin_filter2.h"
@@ -223,6 +225,10 @@ void GraphicsDetector::extractRingsCenters(const Settings& vars, SegmentDeque &s
 {
 	logEnterFunction();
 
+	// ring candidates share one page buffer and the run copies of the segments near them
+	std::map<const Segment*, SegmentRuns> packed;
+	Image others;
+
 	for (SegmentDeque::iterator it = segments.begin(); it != segments.end();)
 	{      
 		if (absolute((*it)->getRatio() - vars.graph.RatioSub) < vars.graph.RatioTresh)
@@ -248,18 +254,32 @@ void GraphicsDetector::extractRingsCenters(const Settings& vars, SegmentDeque &s
 				{	
 					// check circle is inside convex and nothing is inside circle
 
-					Image others(vars.general.ImageWidth, vars.general.ImageHeight);
+					if (others.getWidth() != vars.general.ImageWidth || others.getHeight() != vars.general.ImageHeight)
+						others.init(vars.general.ImageWidth, vars.general.ImageHeight);
 					others.fillWhite();
 
+					int center_x = (*it)->getX() + (*it)->getWidth() / 2;
+					int center_y = (*it)->getY() + (*it)->getHeight() / 2;
+
+					// rays below are cast up to 2 * radius, farther segments are not drawn
+					int reach = (int)ceil(2.0 * radius) + 1;
+
 					for (SegmentDeque::iterator it2 = segments.begin(); it2 != segments.end(); ++it2)
 						if (it != it2)
-							ImageUtils::putSegment(others, *(*it2), true);
+						{
+							const Segment* seg = *it2;
+							if (seg->getX() > center_x + reach || seg->getX() + seg->getWidth() < center_x - reach ||
+							    seg->getY() > center_y + reach || seg->getY() + seg->getHeight() < center_y - reach)
+								continue;
+
+							std::map<const Segment*, SegmentRuns>::iterator packed_it = packed.find(*it2);
+							if (packed_it == packed.end())
+								packed_it = packed.insert(std::make_pair(*it2, SegmentRuns(**it2))).first;
+							ImageUtils::putSegment(others, packed_it->second, true);
+						}
 					
 					getLogExt().appendImage("Others", others);
 
-					int center_x = (*it)->getX() + (*it)->getWidth() / 2;
-					int center_y = (*it)->getY() + (*it)->getHeight() / 2;
-
 					int intersections_outside = 0;
 					int intersections_inside = 0;
 
@@ -25,8 +25,94 @@
 #include "exception.h"
 #include "segment.h"
 
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGO_IMAGE_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace imago;
 
+/**
+ * @brief Returns index of the first not white pixel of row, or length if there are none
+ */
+static int findFilled(const byte* row, int length)
+{
+	int x = 0;
+#ifdef IMAGO_IMAGE_SSE2
+	const __m128i white = _mm_set1_epi8((char)255);
+	for (; x + 16 <= length; x += 16)
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(row + x)), white)) != 0xFFFF)
+			break;
+#endif
+	for (; x < length; x++)
+		if (row[x] != 255)
+			return x;
+	return length;
+}
+
+/**
+ * @brief Returns index of the last not white pixel of row, or -1 if there are none
+ */
+static int findFilledBackward(const byte* row, int length)
+{
+	int x = length;
+#ifdef IMAGO_IMAGE_SSE2
+	const __m128i white = _mm_set1_epi8((char)255);
+	for (; x >= 16; x -= 16)
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(row + x - 16)), white)) != 0xFFFF)
+			break;
+#endif
+	for (x--; x >= 0; x--)
+		if (row[x] != 255)
+			return x;
+	return -1;
+}
+
+/**
+ * @brief Adds counts of black and white pixels of row
+ */
+static void countRowColors(const byte* row, int length, int& black, int& white)
+{
+	int x = 0;
+#ifdef IMAGO_IMAGE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i full = _mm_set1_epi8((char)255);
+	while (x + 16 <= length)
+	{
+		// byte counters are flushed before they overflow
+		int blocks = (length - x) / 16;
+		if (blocks > 255)
+			blocks = 255;
+
+		__m128i acc_black = zero, acc_white = zero;
+		for (int b = 0; b < blocks; b++, x += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(row + x));
+			acc_black = _mm_sub_epi8(acc_black, _mm_cmpeq_epi8(v, zero));
+			acc_white = _mm_sub_epi8(acc_white, _mm_cmpeq_epi8(v, full));
+		}
+
+		acc_black = _mm_sad_epu8(acc_black, zero);
+		acc_white = _mm_sad_epu8(acc_white, zero);
+		black += _mm_cvtsi128_si32(acc_black) + _mm_cvtsi128_si32(_mm_srli_si128(acc_black, 8));
+		white += _mm_cvtsi128_si32(acc_white) + _mm_cvtsi128_si32(_mm_srli_si128(acc_white, 8));
+	}
+#endif
+	for (; x < length; x++)
+	{
+		black += (row[x] == 0);
+		white += (row[x] == 255);
+	}
+}
+
+void Image::getColorCounts(int& black, int& white, int& other) const
+{
+	black = white = 0;
+	for (int y = 0; y < rows; y++)
+		countRowColors(ptr(y), cols, black, white);
+	other = rows * cols - black - white;
+}
+
 /** 
  * @brief Crops image
  */
@@ -37,41 +123,36 @@ void Image::crop(int left, int top, int right, int bottom, int* shift_x, int* sh
    
    if (left == -1 || right == -1 || top == -1 || bottom == -1)
    {
-	   for (left = 0; left < w; left++)
-		   for (int y = 0; y < h; y++)
-			   if (isFilled(left, y))
-			   {
-				   goto left_done;
-			   }
-
-	   left_done:
-	   
-	   for (right = w-1; right >= left; right--)
-		   for (int y = 0; y < h; y++)
-			   if (isFilled(right, y))
-			   {
-				   goto right_done;
-			   }
-
-	   right_done:
-	   
+	   // empty rows are skipped whole, then the rows between are searched only outside the found columns
 	   for (top = 0; top < h; top++)
-		   for (int x = 0; x < w; x++)
-			   if (isFilled(x, top))
-			   {
-				   goto top_done;
-			   }
-
-	   top_done:
-	   
-	   for (bottom = h-1; bottom >= top; bottom--)
-		   for (int x = 0; x < w; x++)
-			   if (isFilled(x, bottom))
-			   {
-				   goto bottom_done;
-			   }
-
-	   bottom_done: ;
+		   if (findFilled(ptr(top), w) < w)
+			   break;
+
+	   if (top == h)
+	   {
+		   left = w;
+		   right = w - 1;
+		   bottom = h - 1;
+	   }
+	   else
+	   {
+		   for (bottom = h - 1; bottom > top; bottom--)
+			   if (findFilled(ptr(bottom), w) < w)
+				   break;
+
+		   left = w;
+		   right = -1;
+		   for (int y = top; y <= bottom; y++)
+		   {
+			   const byte* row = ptr(y);
+			   int first = findFilled(row, left);
+			   if (first < left)
+				   left = first;
+			   int last = findFilledBackward(row + right + 1, w - right - 1);
+			   if (last >= 0)
+				   right += last + 1;
+		   }
+	   }
    }
 
    if (left >= 0 && right >= 0 && top >= 0 && bottom >= 0)
@@ -59,9 +59,7 @@ namespace imago
 
 		inline void fillWhite()
 		{
-			for (int y = 0; y < rows; y++)
-				for (int x = 0; x < cols; x++)
-					getByte(x,y) = 255;
+			setTo(cv::Scalar(255));
 		}
 
 		inline const int &getWidth() const
@@ -102,11 +100,13 @@ namespace imago
 
 		inline void invertColor()
 		{
-			for (int y = 0; y < getHeight(); y++)
-				for (int x = 0; x < getWidth(); x++)
-					getByte(x,y) = 255 - getByte(x,y);
+			// 255 - value is the bitwise negation for bytes
+			cv::bitwise_not(*this, *this);
 		}
 
+		// counts pure black, pure white and all the other pixels in one pass
+		void getColorCounts(int& black, int& white, int& other) const;
+
 		void crop(int left = -1, int top = -1, int right = -1, int bottom = -1, int* shift_x = NULL, int* shift_y = NULL);
       
 		inline void extractRect( int x1, int y1, int x2, int y2, Image &res ) const
@@ -126,12 +126,8 @@ namespace imago
       	        
 		inline double density() const
 		{
-			int density = 0;
-			for (int y = 0; y < rows; y++)
-				for (int x = 0; x < cols; x++)
-					if (getByte(x,y) == 0)
-						density++;
-			return (double)density/(cols*rows);
+			int total = cols * rows;
+			return (double)(total - cv::countNonZero(*this)) / total;
 		}
       
 		inline int mean() const
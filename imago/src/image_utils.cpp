@@ -16,6 +16,7 @@
 #include <cstdarg>
 #include <algorithm>
 #include <string>
+#include <string.h>
 
 #include <opencv2/opencv.hpp>
 //#include <opencv/highgui.h>
@@ -26,12 +27,103 @@
 #include "output.h"
 #include "scanner.h"
 #include "segment.h"
+#include "segment_runs.h"
+#include "segment_tools.h"
 #include "thin_filter2.h"
 #include "vec2d.h"
 #include "log_ext.h"
 #include "failsafe_png.h"
 #include "stat_utils.h"
 
+#if defined(CV_VERSION_MAJOR) && !defined(CV_VERSION_EPOCH) && (CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 2))
+#define IMAGO_REDUCED_DECODE
+#endif
+
+using imago::byte;
+
+// frame headers normally follow within the EXIF / ICC segments
+static const size_t JPEG_HEADER_PROBE = 256 * 1024;
+
+/**
+ * @brief Reads the frame size from the SOFn marker of JPEG data, false if data is not JPEG
+ * or the marker is beyond size
+ */
+static bool getJpegSize(const byte* data, size_t size, int& width, int& height)
+{
+	if (data == NULL || size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+		return false;
+
+	size_t pos = 2;
+	while (pos + 4 <= size)
+	{
+		if (data[pos] != 0xFF)
+			return false;
+		byte marker = data[pos + 1];
+		if (marker == 0xFF) // fill byte
+		{
+			pos++;
+			continue;
+		}
+		if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) // standalone markers
+		{
+			pos += 2;
+			continue;
+		}
+		if (marker == 0xD9 || marker == 0xDA) // image data without a frame header
+			return false;
+
+		size_t length = (data[pos + 2] << 8) | data[pos + 3];
+		if (length < 2)
+			return false;
+		if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+		{
+			if (pos + 9 > size)
+				return false;
+			height = (data[pos + 5] << 8) | data[pos + 6];
+			width = (data[pos + 7] << 8) | data[pos + 8];
+			return width > 0 && height > 0;
+		}
+		pos += 2 + length;
+	}
+	return false;
+}
+
+/**
+ * @brief Returns the largest of 1, 2, 4, 8 keeping the longer side not below max_dim
+ */
+static int getDecodeReduction(int width, int height, int max_dim)
+{
+	int factor = 1;
+	if (max_dim > 0)
+		while (factor < 8 && std::max(width, height) / (factor * 2) >= max_dim)
+			factor *= 2;
+	return factor;
+}
+
+static int reducedGrayscaleFlags(int factor)
+{
+#ifdef IMAGO_REDUCED_DECODE
+	switch (factor)
+	{
+	case 2: return cv::IMREAD_REDUCED_GRAYSCALE_2;
+	case 4: return cv::IMREAD_REDUCED_GRAYSCALE_4;
+	case 8: return cv::IMREAD_REDUCED_GRAYSCALE_8;
+	}
+#endif
+	return 0 /*Grayscale*/;
+}
+
+/**
+ * @brief Brings a grayscale decode to the reduced size where the decoder can not scale itself
+ */
+static void finishReduction(cv::Mat& mat, int factor)
+{
+#ifndef IMAGO_REDUCED_DECODE
+	if (factor > 1 && !mat.empty())
+		cv::resize(mat, mat, cv::Size((mat.cols + factor - 1) / factor, (mat.rows + factor - 1) / factor), 0, 0, cv::INTER_AREA);
+#endif
+}
+
 namespace imago
 {
    bool ImageUtils::testSlashLine(const Settings& vars, Segment &img, double *angle, double eps )
@@ -44,8 +136,9 @@ namespace imago
 
       Image tmp;   
 
-      tmp.copy(img);   
-      ThinFilter2(tmp).apply();   
+      // thinning is cached on the segment and shared by the calls with different eps
+      const Image &thinned = SegmentTools::getThinned(img);
+      tmp.copy(thinned);
    
       thetha = HALF_PI + atan2((double)img.getHeight(), (double)img.getWidth());
       r = 0;
@@ -60,8 +153,7 @@ namespace imago
          return true;
       }
 
-      tmp.copy(img);
-      ThinFilter2(tmp).apply();   
+      tmp.copy(thinned);
 
       thetha = -thetha;
       r = cos(thetha) * img.getWidth();
@@ -134,6 +226,31 @@ namespace imago
          }
    }
 
+   void ImageUtils::putSegment( Image &img, const SegmentRuns &seg, bool careful )
+   {
+      int x_min = std::max(0, seg.getX()), x_max = std::min(img.getWidth(), seg.getX() + seg.getWidth());
+
+      for (int j = 0; j < seg.getHeight(); j++)
+      {
+         int y = j + seg.getY();
+         if (y < 0 || y >= img.getHeight())
+            continue;
+
+         byte* row = img.ptr(y);
+         if (!careful && x_min < x_max)
+            memset(row + x_min, 255, x_max - x_min);
+
+         for (const SegmentRuns::Run* run = seg.getRowBegin(j); run != seg.getRowEnd(j); ++run)
+         {
+            int x1 = std::max(x_min, seg.getX() + run->x1);
+            int x2 = std::min(x_max - 1, seg.getX() + run->x2);
+            for (int x = x1; x <= x2; x++)
+               if (!careful || row[x] == 255)
+                  row[x] = 0;
+         }
+      }
+   }
+
    void ImageUtils::copyImageToMat ( const Image &img, cv::Mat &mat)
    {
 	   img.copyTo(mat);
@@ -166,38 +283,57 @@ namespace imago
             img.getByte(i, j) = mat.at<unsigned char>(j, i);*/
    }
 
-   void ImageUtils::loadImageFromBuffer( const std::vector<byte> &buffer, Image &img )
+   void ImageUtils::loadImageFromBuffer( const std::vector<byte> &buffer, Image &img, int max_dim )
    {
-      cv::Mat mat = cv::imdecode(cv::Mat(buffer), 0);
+      int width = 0, height = 0, factor = 1;
+      if (max_dim > 0 && getJpegSize(buffer.empty() ? NULL : &buffer[0], buffer.size(), width, height))
+         factor = getDecodeReduction(width, height, max_dim);
+
+      cv::Mat mat = cv::imdecode(cv::Mat(buffer), reducedGrayscaleFlags(factor));
       if (mat.empty())
          throw ImagoException("Image data is invalid");
+      finishReduction(mat, factor);
       copyMatToImage(mat, img);
    }
 
-   void ImageUtils::loadImageFromFile( Image &img, const char *format, ... )
+   static void loadImageFile( Image &img, const std::string &fname, int max_dim )
    {
-	   logEnterFunction();
-
-      char str[MAX_TEXT_LINE];
-      va_list args;
-
-      va_start(args, format);   
-      vsnprintf(str, sizeof(str), format, args);
-      va_end(args);
-
-      const char *FileName = str;
       img.clear(); 
-   
-      std::string fname(FileName);
 
       if (fname.length() < 5)
          throw ImagoException("Unknown file format " + fname);
 
-      FILE *f = fopen(fname.c_str(), "r");
+      FILE *f = fopen(fname.c_str(), "rb");
       if (f == 0)
          throw FileNotFoundException(fname.c_str());
+
+      int width = 0, height = 0;
+      bool jpeg = false;
+      if (max_dim > 0)
+      {
+         std::vector<byte> header(JPEG_HEADER_PROBE);
+         size_t got = fread(&header[0], 1, header.size(), f);
+         jpeg = getJpegSize(&header[0], got, width, height);
+      }
       fclose(f);
 
+      if (jpeg)
+      {
+         // no alpha channel to care about, so the decoder may skip the color conversion and the scale
+         int factor = getDecodeReduction(width, height, max_dim);
+         getLogExt().append("JPEG width", width);
+         getLogExt().append("JPEG height", height);
+         getLogExt().append("Decode reduction", factor);
+         cv::Mat mat = cv::imread(fname, reducedGrayscaleFlags(factor));
+         if (!mat.empty())
+         {
+            finishReduction(mat, factor);
+            ImageUtils::copyMatToImage(mat, img);
+            return;
+         }
+         getLogExt().appendText("Reduced decode failed, loading in full");
+      }
+
       cv::Mat mat = cv::imread(fname, -1 /*BGRA*/);
 
       if (mat.empty())
@@ -242,10 +378,38 @@ namespace imago
 			  getLogExt().appendText("Unknown image type, attempt to reload as grayscale");
 			  mat = cv::imread(fname, 0 /*Grayscale*/);
 		  }
-		  copyMatToImage(mat, img);
+		  ImageUtils::copyMatToImage(mat, img);
 	  }
    }
 
+   void ImageUtils::loadImageFromFile( Image &img, const char *format, ... )
+   {
+	   logEnterFunction();
+
+      char str[MAX_TEXT_LINE];
+      va_list args;
+
+      va_start(args, format);   
+      vsnprintf(str, sizeof(str), format, args);
+      va_end(args);
+
+      loadImageFile(img, str, 0);
+   }
+
+   void ImageUtils::loadImageFromFileReduced( Image &img, int max_dim, const char *format, ... )
+   {
+	   logEnterFunction();
+
+      char str[MAX_TEXT_LINE];
+      va_list args;
+
+      va_start(args, format);   
+      vsnprintf(str, sizeof(str), format, args);
+      va_end(args);
+
+      loadImageFile(img, str, max_dim);
+   }
+
    void ImageUtils::saveImageToFile( const Image &img, const char *format, ... )
    {
       char str[MAX_TEXT_LINE];
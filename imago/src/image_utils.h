@@ -28,6 +28,7 @@ namespace imago
 {
    class Image;
    class Segment;
+   class SegmentRuns;
 
    class ImageUtils
    {
@@ -38,12 +39,19 @@ namespace imago
       static void loadImageFromFile( Image &img, const char *FileName, ... );
       static void saveImageToFile( const Image &img, const char *FileName, ... );
 
-      static void loadImageFromBuffer( const std::vector<byte> &buffer, Image &img);
+      // JPEG data is decoded straight to grayscale at the coarsest 1/2, 1/4 or 1/8 scale
+      // keeping the longer side not below max_dim; other formats (or max_dim <= 0) load in full
+      static void loadImageFromFileReduced( Image &img, int max_dim, const char *FileName, ... );
+
+      static void loadImageFromBuffer( const std::vector<byte> &buffer, Image &img, int max_dim = 0 );
       static void saveImageToBuffer( const Image &img, const std::string &format, std::vector<byte> &buffer );
 
       static void putSegment( Image &img, const Segment &seg, bool careful = true );
       static void cutSegment( Image &img, const Segment &seg, bool forceCut = false, byte val = 255 );
 
+      // the same for run-length segments, touches only black pixels and the bounding box for careless put
+      static void putSegment( Image &img, const SegmentRuns &seg, bool careful = true );
+
       static bool testSlashLine(const Settings& vars, Segment &img, double *angle, double eps );
       static bool isThinCircle(const Settings& vars, Image &seg, double &radius, bool asChar = false);
 	  static double estimateLineThickness(Image &bwimg, int grid);
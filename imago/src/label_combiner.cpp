@@ -80,7 +80,10 @@ void LabelCombiner::_locateLabels(const Settings& vars)
 	  Segment *s_e = boost::get(img_ptrs, boost::vertex(boost::target(*ei, seg_graph), seg_graph));
       
       ++next;
-	  if (SegmentTools::getRealDistance(*s_b,*s_e, SegmentTools::dtEuclidian) < distance_constraint &&
+	  // rectangles distance rejects far pairs before the pixel distances are computed
+	  if (SegmentTools::getDistanceLowerBound(*s_b,*s_e, SegmentTools::dtEuclidian) < distance_constraint &&
+		  SegmentTools::getDistanceLowerBound(*s_b,*s_e, SegmentTools::dtDeltaY) < distance_constraint_y &&
+		  SegmentTools::getRealDistance(*s_b,*s_e, SegmentTools::dtEuclidian) < distance_constraint &&
 		  SegmentTools::getRealDistance(*s_b,*s_e, SegmentTools::dtDeltaY) < distance_constraint_y )
 		  continue;
 	  else
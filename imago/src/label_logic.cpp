@@ -303,6 +303,7 @@ void LabelLogic::recognizeLabel(const Settings& vars, Label& label )
 
    setSuperatom(&label.satom);
 
+   if (getLogExt().loggingEnabled())
    {
 	   Segment temp(vars.general.ImageWidth, vars.general.ImageHeight, 0, 0);
 	   temp.fillWhite();
@@ -25,9 +25,17 @@ namespace imago
 	}
 
 	RectShapedBounding::RectShapedBounding(const Points2i& pts)
+	{
+		if (pts.empty())
+			bound = RectShapedBounding(NULL, NULL).bound;
+		else
+			bound = RectShapedBounding(&pts[0], &pts[0] + pts.size()).bound;
+	}
+
+	RectShapedBounding::RectShapedBounding(const Vec2i* first, const Vec2i* last)
 	{
 		int min_x = INT_MAX, min_y = INT_MAX, max_x = 0, max_y = 0;
-		for (Points2i::const_iterator it = pts.begin(); it != pts.end(); ++it)
+		for (const Vec2i* it = first; it != last; ++it)
 		{
 			min_x = std::min(min_x, it->x);
 			min_y = std::min(min_y, it->y);
@@ -27,6 +27,7 @@ namespace imago
 	public:
 		RectShapedBounding(const RectShapedBounding& src);
 		RectShapedBounding(const Points2i& pts);
+		RectShapedBounding(const Vec2i* first, const Vec2i* last);
 
 		inline const Rectangle& getBounding() const { return bound; }
 
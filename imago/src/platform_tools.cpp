@@ -33,6 +33,80 @@ bool platform::checkMemoryFail(int amount)
 }
 
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+
+#ifdef _MSC_VER
+#include <intrin.h>
+
+static void cpuidHelper(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+{
+	int info[4];
+	__cpuidex(info, (int)leaf, (int)subleaf);
+	for (int u = 0; u < 4; u++)
+		regs[u] = (unsigned int)info[u];
+}
+
+static unsigned long long xgetbvHelper()
+{
+	return _xgetbv(0);
+}
+#else
+#include <cpuid.h>
+
+static void cpuidHelper(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+{
+	regs[0] = regs[1] = regs[2] = regs[3] = 0;
+	if (leaf <= __get_cpuid_max(0, 0))
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+}
+
+static unsigned long long xgetbvHelper()
+{
+	unsigned int eax, edx;
+	__asm__ __volatile__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+}
+#endif
+
+static unsigned int detectCpuFeatures()
+{
+	unsigned int result = 0;
+	unsigned int regs[4];
+
+	cpuidHelper(1, 0, regs);
+	if (regs[3] & (1u << 26)) // edx: SSE2
+		result |= platform::cfSSE2;
+
+	bool osxsave = (regs[2] & (1u << 27)) != 0; // ecx: OSXSAVE
+	bool avx = (regs[2] & (1u << 28)) != 0;     // ecx: AVX
+
+	// AVX2 also requires the OS to preserve ymm registers (XCR0 bits 1 and 2)
+	if (osxsave && avx && (xgetbvHelper() & 0x6) == 0x6)
+	{
+		cpuidHelper(7, 0, regs);
+		if (regs[1] & (1u << 5)) // ebx: AVX2
+			result |= platform::cfAVX2;
+	}
+
+	return result;
+}
+
+#else
+
+static unsigned int detectCpuFeatures()
+{
+	return 0; // non-x86 platform, scalar code only
+}
+
+#endif
+
+unsigned int platform::CPU_FEATURES()
+{
+	static unsigned int features = detectCpuFeatures();
+	return features;
+}
+
+
 #ifdef _WIN32 // ------------------- Windows -------------------
 #include <direct.h>
 #include <Windows.h>
@@ -65,6 +139,39 @@ std::string platform::getLineEndings()
 	return "\r\n";
 }
 
+const void* platform::MEMORY_MAP_FILE(const std::string& filename, size_t& size)
+{
+	size = 0;
+
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, 
+		                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	const void* result = NULL;
+	LARGE_INTEGER file_size;
+	if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping != NULL)
+		{
+			result = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (result != NULL)
+				size = (size_t)file_size.QuadPart;
+			CloseHandle(mapping); // the view keeps the mapping alive
+		}
+	}
+
+	CloseHandle(file);
+	return result;
+}
+
+void platform::MEMORY_UNMAP_FILE(const void* data, size_t size)
+{
+	if (data != NULL)
+		UnmapViewOfFile(data);
+}
+
 int platform::CALL(const std::string& executable, const std::string& parameters, int timelimit)
 {	
     int result = 0; 
@@ -143,6 +250,9 @@ int platform::CALL(const std::string& executable, const std::string& parameters,
 #else // ------------------- POSIX -------------------
 
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <errno.h>
 
 int platform::MKDIR(const std::string& directory)
@@ -170,5 +280,35 @@ std::string platform::getLineEndings()
 	return "\n";
 }
 
+const void* platform::MEMORY_MAP_FILE(const std::string& filename, size_t& size)
+{
+	size = 0;
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	const void* result = NULL;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (data != MAP_FAILED)
+		{
+			result = data;
+			size = (size_t)st.st_size;
+		}
+	}
+
+	close(fd); // the mapping stays valid
+	return result;
+}
+
+void platform::MEMORY_UNMAP_FILE(const void* data, size_t size)
+{
+	if (data != NULL)
+		munmap(const_cast<void*>(data), size);
+}
+
 #endif
 
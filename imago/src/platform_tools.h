@@ -37,6 +37,22 @@ namespace platform
 
 	// returns true if memory allocation of 'amount' MB is failed. memory is released instantly.
 	bool checkMemoryFail(int amount = 32);
+
+	// SIMD instruction sets usable on the current CPU and OS
+	enum CpuFeature
+	{
+		cfSSE2 = 1,
+		cfAVX2 = 2
+	};
+
+	// returns CpuFeature bitmask, detected once
+	unsigned int CPU_FEATURES();
+
+	// maps the whole file read-only, returns NULL on failure
+	const void* MEMORY_MAP_FILE(const std::string& filename, size_t& size);
+
+	// releases memory mapped by MEMORY_MAP_FILE
+	void MEMORY_UNMAP_FILE(const void* data, size_t size);
 }
 
 #endif //_platform_tools_h
@@ -23,26 +23,20 @@
 #include "log_ext.h"
 #include "filters_list.h"
 #include "prefilter_entry.h"
+#include "prefilter_context.h"
 
 namespace imago
 {
 	namespace prefilter_basic
 	{
-		bool prefilterBinarizedFullsize(Settings& vars, Image &image)
+		bool prefilterBinarizedFullsize(Settings& vars, PrefilterContext& context, Image &image)
 		{
 			logEnterFunction();		
 
-			getLogExt().appendImage("Source", image);
+			getLogExt().appendImage("Source", context.getSource());
 
 			int white_count = 0, black_count = 0, others_count = 0;
-			for (int y = 0; y < image.getHeight(); y++)
-				for (int x = 0; x < image.getWidth(); x++)
-					if (image.getByte(x, y) == 0)
-						black_count++;
-					else if (image.getByte(x, y) == 255)
-						white_count++;
-					else 
-						others_count++;
+			context.getColorCounts(black_count, white_count, others_count);
 
 			getLogExt().append("white_count", white_count);
 			getLogExt().append("black_count", black_count);
@@ -51,24 +45,27 @@ namespace imago
 			if (vars.prefilterCV.MaxNonBWPixelsProportion * others_count < black_count + white_count)
 			{	
 				getLogExt().appendText("image is binarized");
+				image.copy(context.getSource());
 				if (others_count > 0)
 				{
 					int gap = vars.prefilterCV.BinarizerFrameGap;
 					getLogExt().appendText("Fixup other colors");
 					for (int y = 0; y < image.getHeight(); y++)
 					{
+						byte* row = image.ptr(y);
+						bool inner_row = y > gap && y + gap < image.getHeight();
 						for (int x = 0; x < image.getWidth(); x++)
 						{
-							if (image.getByte(x,y) != 0 && image.getByte(x,y) != 255)
+							if (row[x] != 0 && row[x] != 255)
 							{
-								if (x > gap && y > gap && x + gap < image.getWidth() && y + gap < image.getHeight() &&
-									image.getByte(x, y) < vars.prefilterCV.BinarizerThreshold )
+								if (inner_row && x > gap && x + gap < image.getWidth() &&
+									row[x] < vars.prefilterCV.BinarizerThreshold )
 								{
-									image.getByte(x, y) = 0;
+									row[x] = 0;
 								}
 								else
 								{
-									image.getByte(x, y) = 255;
+									row[x] = 255;
 								}
 							}
 						}
@@ -84,21 +81,9 @@ namespace imago
 					}
 					else
 					{
+						// only black and white pixels are left here
 						getLogExt().appendText("image is inversed");
-						for (int y = 0; y < image.getHeight(); y++)
-						{
-							for (int x = 0; x < image.getWidth(); x++)
-							{
-								if (image.getByte(x,y) == 0)
-								{
-									image.getByte(x, y) = 255;
-								}
-								else
-								{
-									image.getByte(x, y) = 0;
-								}
-							}
-						}
+						image.invertColor();
 					}
 				}
 
@@ -130,77 +115,32 @@ namespace imago
 			}
 		}	
 
-		bool prefilterBasicForceDownscale(Settings& vars, Image &image)
-		{
-			logEnterFunction();
-
-			double base_ratio = 2.0;
-			double rescale_ratio = 1.0;
-
-			{
-				double remp_rescale_ratio = std::max(image.cols, image.rows) / vars.csr.RescaleImageDimensions;
-				if (remp_rescale_ratio > rescale_ratio)
-					rescale_ratio = remp_rescale_ratio;
-			}
-
-			if (vars.dynamic.CapitalHeight <= EPS)
-			{
-				base_ratio = 4.0;
-			}
-			else
-			{
-				// 16 gives 93.139
-				const double preferred_cap_height = 16.0;
-				double temp_base_ratio = vars.dynamic.CapitalHeight / preferred_cap_height;
-				if (temp_base_ratio > base_ratio)
-					base_ratio = temp_base_ratio;
-			}
-
-			double ratio = base_ratio * rescale_ratio;
-			getLogExt().append("ratio", ratio);
-
-			cv::resize(image, image, cv::Size((int)(image.cols / ratio), (int)(image.rows / ratio)),
-				0.0, 0.0, cv::INTER_AREA);
-
-			return prefilterBasicFullsize(vars, image);
-		}
-
-		bool prefilterBasicFullsize(Settings& vars, Image& raw)
+		// binarizes the source layer of given size into output
+		static bool prefilterLayer(Settings& vars, PrefilterContext& context, const cv::Size& size, Image& output)
 		{
-			static const int CV_THRESH_BINARY = 0;
-
 			logEnterFunction();
 
-			cv::Mat grayFrame;
-			ImageUtils::copyImageToMat(raw, grayFrame);
-		
-			cv::Mat reduced2x((grayFrame.rows+1)/2, (grayFrame.cols+1)/2, CV_8U);
-			cv::pyrDown(grayFrame, reduced2x);
-
-			cv::Mat smoothed2x(grayFrame.rows, grayFrame.cols, CV_8U);
-			cv::pyrUp(reduced2x, smoothed2x);		
+			const cv::Mat& layer = context.getLayer(size);
 
-			cv::Mat strong;
-			cv::adaptiveThreshold(smoothed2x, strong, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, CV_THRESH_BINARY, (vars.prefilterCV.StrongBinarizeSize) + (vars.prefilterCV.StrongBinarizeSize) % 2 + 1, vars.prefilterCV.StrongBinarizeTresh);
+			const cv::Mat& strong = context.getAdaptiveThreshold(size, (vars.prefilterCV.StrongBinarizeSize) + (vars.prefilterCV.StrongBinarizeSize) % 2 + 1, vars.prefilterCV.StrongBinarizeTresh);
 			getLogExt().appendMat("strong", strong);
 
-			cv::Mat weak;
-			cv::adaptiveThreshold(smoothed2x, weak,   255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, CV_THRESH_BINARY, (vars.prefilterCV.WeakBinarizeSize)   + (vars.prefilterCV.WeakBinarizeSize) % 2 + 1,   vars.prefilterCV.WeakBinarizeTresh);	
+			const cv::Mat& weak = context.getAdaptiveThreshold(size, (vars.prefilterCV.WeakBinarizeSize)   + (vars.prefilterCV.WeakBinarizeSize) % 2 + 1,   vars.prefilterCV.WeakBinarizeTresh);	
 			getLogExt().appendMat("weak",   weak);
 
 			cv::Mat otsu;
 			if (vars.prefilterCV.UseOtsuPixelsAddition)
 			{
-				cv::threshold(smoothed2x, otsu, vars.prefilterCV.OtsuThresholdValue, 255, cv::THRESH_OTSU);
+				otsu = context.getOtsuThreshold(size);
 				getLogExt().appendMat("otsu",   otsu);
 			}
 
-			Image* output = NULL;
+			Image* result = NULL;
 			Rectangle viewport;
 			int tresholdPassSum = 0, tresholdPassCount = 0;
 
-			int borderX = raw.getWidth()  / vars.prefilterCV.BorderPartProportion + 1;
-			int borderY = raw.getHeight() / vars.prefilterCV.BorderPartProportion + 1;
+			int borderX = layer.cols / vars.prefilterCV.BorderPartProportion + 1;
+			int borderY = layer.rows / vars.prefilterCV.BorderPartProportion + 1;
 
 			for (int iter = 0; iter <= (vars.prefilterCV.UseOtsuPixelsAddition ? 1 : 0); iter++)
 			{
@@ -211,12 +151,12 @@ namespace imago
 					ImageUtils::copyMatToImage(otsu, bin);
 
 
-				WeakSegmentator ws(raw.getWidth(), raw.getHeight());
+				WeakSegmentator ws(layer.cols, layer.rows);
 				ws.appendData(bin);
 
-				if (output == NULL)
+				if (result == NULL)
 				{
-					viewport = Rectangle(0, 0, raw.getWidth(), raw.getHeight());
+					viewport = Rectangle(0, 0, layer.cols, layer.rows);
 					Rectangle temp;
 					if (ws.needCrop(vars, temp, vars.prefilterCV.MaxRectangleCropLineWidth) &&
 						temp.width > vars.csr.SmallImageDim && temp.height > vars.csr.SmallImageDim)
@@ -225,19 +165,19 @@ namespace imago
 						viewport = temp;
 					}
 
-					output = new Image(viewport.width, viewport.height);
-					output->fillWhite();
+					result = new Image(viewport.width, viewport.height);
+					result->fillWhite();
 				}
 
-				for (WeakSegmentator::SegMap::const_iterator it = ws.SegmentPoints.begin(); it != ws.SegmentPoints.end(); ++it)
+				for (int id = 1; id <= ws.getSegmentsCount(); id++)
 				{
-					const Points2i& p = it->second;
+					WeakSegmentator::PointsRange p = ws.getSegmentPoints(id);
 		
 					int good = 0, bad = 0;
 					for (size_t u = 0; u < p.size(); u++)
 					{
 						if (p[u].x > borderX && p[u].y > borderY
-							&& p[u].x < raw.getWidth() - borderX && p[u].y < raw.getHeight() - borderY
+							&& p[u].x < layer.cols - borderX && p[u].y < layer.rows - borderY
 							&& strong.at<unsigned char>(p[u].y, p[u].x) == 0)
 							good++;
 						else
@@ -249,7 +189,7 @@ namespace imago
 						if (getLogExt().loggingEnabled())
 						{
 							std::map<std::string, int> temp;
-							temp["Segment id"] = it->first;
+							temp["Segment id"] = id;
 							temp["Good points"] = good;
 							temp["Bad points"] = bad;
 							getLogExt().appendMap("Append segment", temp);
@@ -259,31 +199,82 @@ namespace imago
 						{
 							int x = p[u].x - viewport.x;
 							int y = p[u].y - viewport.y;
-							if (x >= 0 && y >= 0 && x < output->getWidth() && y < output->getHeight())
+							if (x >= 0 && y >= 0 && x < result->getWidth() && y < result->getHeight())
 							{
-								tresholdPassSum += raw.getByte(x, y);
+								tresholdPassSum += layer.at<unsigned char>(y, x);
 								tresholdPassCount++;
-								output->getByte(x, y) = 0;
+								result->getByte(x, y) = 0;
 							}
 						}
 					}
 				}
 			}
 
-			if (output)
+			if (result)
 			{
-				getLogExt().appendImage("output", *output);
+				getLogExt().appendImage("output", *result);
 
-				raw.copy(*output);
+				output.copy(*result);
 
-				delete output;
-				output = NULL;
+				delete result;
+				result = NULL;
 
 				return true;
 			}
 
 			return false;
 		}
+
+		bool prefilterBasicForceDownscale(Settings& vars, PrefilterContext& context, Image& output)
+		{
+			logEnterFunction();
+
+			const Image& image = context.getSource();
+
+			double base_ratio = 2.0;
+			double rescale_ratio = 1.0;
+
+			{
+				double remp_rescale_ratio = std::max(image.cols, image.rows) / vars.csr.RescaleImageDimensions;
+				if (remp_rescale_ratio > rescale_ratio)
+					rescale_ratio = remp_rescale_ratio;
+			}
+
+			if (vars.dynamic.CapitalHeight <= EPS)
+			{
+				base_ratio = 4.0;
+			}
+			else
+			{
+				// 16 gives 93.139
+				const double preferred_cap_height = 16.0;
+				double temp_base_ratio = vars.dynamic.CapitalHeight / preferred_cap_height;
+				if (temp_base_ratio > base_ratio)
+					base_ratio = temp_base_ratio;
+			}
+
+			double ratio = base_ratio * rescale_ratio;
+			getLogExt().append("ratio", ratio);
+
+			return prefilterLayer(vars, context, cv::Size((int)(image.cols / ratio), (int)(image.rows / ratio)), output);
+		}
+
+		bool prefilterBasicFullsize(Settings& vars, PrefilterContext& context, Image& output)
+		{
+			return prefilterLayer(vars, context, context.getSource().size(), output);
+		}
+
+		bool prefilterBasicFullsize(Settings& vars, Image& raw)
+		{
+			Image output;
+			{
+				PrefilterContext context(raw);
+				if (!prefilterLayer(vars, context, raw.size(), output))
+					return false;
+			}
+			raw.copy(output);
+			return true;
+		}
 	} // end namespace
 
 }
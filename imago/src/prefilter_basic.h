@@ -18,6 +18,7 @@
 
 #include "image.h"
 #include "settings.h"
+#include "prefilter_context.h"
 
 namespace imago
 {
@@ -25,11 +26,14 @@ namespace imago
 	{	
 		// returns true if result image is binarized
 		// may change some pixels inensity if image is already binarized
-		bool prefilterBinarizedFullsize(Settings& vars, Image &image);
+		bool prefilterBinarizedFullsize(Settings& vars, PrefilterContext& context, Image &image);
   
 		// filters image using cv adaptive filtering and cross-correlation
 		bool prefilterBasicFullsize(Settings& vars, Image& raw);
-		bool prefilterBasicForceDownscale(Settings& vars, Image& raw);		
+
+		// the same for the context source, output is filled on success
+		bool prefilterBasicFullsize(Settings& vars, PrefilterContext& context, Image& output);
+		bool prefilterBasicForceDownscale(Settings& vars, PrefilterContext& context, Image& output);		
 	}
 }
 
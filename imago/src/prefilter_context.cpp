@@ -0,0 +1,194 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "prefilter_context.h"
+#include <cstdio>
+#include <algorithm>
+#include "log_ext.h"
+
+namespace imago
+{
+	static size_t matBytes(const cv::Mat& mat)
+	{
+		return mat.empty() ? 0 : mat.total() * mat.elemSize();
+	}
+
+	void PrefilterContext::built()
+	{
+		_built++;
+		getLogExt().append("Prefilter images built", _built);
+	}
+
+	void PrefilterContext::getColorCounts(int& black, int& white, int& other)
+	{
+		if (_colors_ready)
+		{
+			_hits++;
+		}
+		else
+		{
+			_src.getColorCounts(_black, _white, _other);
+			_colors_ready = true;
+			built();
+		}
+		black = _black;
+		white = _white;
+		other = _other;
+	}
+
+	std::string PrefilterContext::getImageClass()
+	{
+		if (!_image_class.empty())
+		{
+			_hits++;
+			return _image_class;
+		}
+
+		int black = 0, white = 0, other = 0;
+		getColorCounts(black, white, other);
+
+		// quarters of the grey levels are enough for the ink ratio and the histogram shape
+		const int channels[] = { 0 };
+		const int bins[] = { 4 };
+		const float levels[] = { 0.0f, 256.0f };
+		const float* ranges[] = { levels };
+		cv::Mat quarters;
+		cv::calcHist(&_src, 1, channels, cv::Mat(), quarters, 1, bins, ranges);
+
+		double total = std::max(1, _src.cols * _src.rows);
+		double ink = quarters.at<float>(0, 0) + quarters.at<float>(1, 0); // levels 0..127
+		double midtones = quarters.at<float>(1, 0) + quarters.at<float>(2, 0); // levels 64..191
+
+		int dim = std::max(_src.cols, _src.rows);
+		int size_class = dim < 800 ? 0 : (dim < 1600 ? 1 : (dim < 3200 ? 2 : 3));
+
+		double ink_ratio = ink / total;
+		int ink_class = ink_ratio < 0.02 ? 0 : (ink_ratio < 0.08 ? 1 : (ink_ratio < 0.2 ? 2 : 3));
+
+		const char* shape = "grey";
+		if (other == 0)
+			shape = "bw";
+		else if (midtones * 10 < total)
+			shape = "bimodal";
+
+		char buf[64];
+		sprintf(buf, "s%d-i%d-%s", size_class, ink_class, shape);
+		_image_class = buf;
+		built();
+		return _image_class;
+	}
+
+	PrefilterContext::Layer& PrefilterContext::findLayer(const cv::Size& size)
+	{
+		Layer& layer = _layers[std::make_pair(size.width, size.height)];
+		if (layer.image.empty())
+		{
+			if (size.width == _src.cols && size.height == _src.rows)
+			{
+				layer.image = _src; // shares the data
+			}
+			else
+			{
+				cv::resize(_src, layer.image, size, 0.0, 0.0, cv::INTER_AREA);
+				built();
+			}
+		}
+		return layer;
+	}
+
+	const cv::Mat& PrefilterContext::getLayer(const cv::Size& size)
+	{
+		bool known = _layers.find(std::make_pair(size.width, size.height)) != _layers.end();
+		Layer& layer = findLayer(size);
+		if (known)
+			_hits++;
+		return layer.image;
+	}
+
+	const cv::Mat& PrefilterContext::getSmoothed(const cv::Size& size)
+	{
+		Layer& layer = findLayer(size);
+		if (layer.smoothed.empty())
+		{
+			cv::Mat reduced2x((layer.image.rows + 1) / 2, (layer.image.cols + 1) / 2, CV_8U);
+			cv::pyrDown(layer.image, reduced2x);
+
+			// twice the reduced size, one pixel more than the layer for odd dimensions
+			cv::pyrUp(reduced2x, layer.smoothed);
+			built();
+		}
+		else
+		{
+			_hits++;
+		}
+		return layer.smoothed;
+	}
+
+	const cv::Mat& PrefilterContext::getAdaptiveThreshold(const cv::Size& size, int block_size, double c)
+	{
+		const cv::Mat& smoothed = getSmoothed(size);
+		cv::Mat& result = findLayer(size).adaptive[std::make_pair(block_size, c)];
+		if (result.empty())
+		{
+			cv::adaptiveThreshold(smoothed, result, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY, block_size, c);
+			built();
+		}
+		else
+		{
+			_hits++;
+		}
+		return result;
+	}
+
+	const cv::Mat& PrefilterContext::getOtsuThreshold(const cv::Size& size)
+	{
+		const cv::Mat& smoothed = getSmoothed(size);
+		cv::Mat& result = findLayer(size).otsu;
+		if (result.empty())
+		{
+			// the threshold value is computed by the method
+			cv::threshold(smoothed, result, 0, 255, cv::THRESH_OTSU);
+			built();
+		}
+		else
+		{
+			_hits++;
+		}
+		return result;
+	}
+
+	void PrefilterContext::reset()
+	{
+		_layers.clear();
+		_colors_ready = false;
+		_image_class.clear();
+		_order.clear();
+	}
+
+	size_t PrefilterContext::getMemoryUsage() const
+	{
+		size_t result = 0;
+		for (Layers::const_iterator it = _layers.begin(); it != _layers.end(); ++it)
+		{
+			// the layer of the source size shares its data
+			if (it->second.image.data != _src.data)
+				result += matBytes(it->second.image);
+			result += matBytes(it->second.smoothed) + matBytes(it->second.otsu);
+			for (std::map<std::pair<int, double>, cv::Mat>::const_iterator a = it->second.adaptive.begin(); 
+				 a != it->second.adaptive.end(); ++a)
+				result += matBytes(a->second);
+		}
+		return result;
+	}
+}
@@ -0,0 +1,93 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _prefilter_context_h
+#define _prefilter_context_h
+
+#include <map>
+#include <string>
+#include <vector>
+#include "image.h"
+
+namespace imago
+{
+	// source image of the prefilters chain with its derived images (downscaled layers, smoothed
+	// images and threshold maps), computed on the first request and shared by the filters and
+	// their retries; the source should not be changed while the context is used, otherwise 
+	// reset() is required. Filters are applied sequentially, so the context is not synchronized.
+	class PrefilterContext
+	{
+	public:
+		PrefilterContext(const Image& src) : _src(src), _colors_ready(false), _hits(0), _built(0) {}
+
+		const Image& getSource() const { return _src; }
+
+		// black, white and other pixels of the source
+		void getColorCounts(int& black, int& white, int& other);
+
+		// cheap features of the source the filters outcome depends on: size, ink ratio and histogram shape
+		std::string getImageClass();
+
+		// filters list indexes in the order the chain tries them, empty until the chain starts
+		const std::vector<int>& getFilterOrder() const { return _order; }
+		void setFilterOrder(const std::vector<int>& order) { _order = order; }
+
+		// source resized with INTER_AREA, the source itself for its own size
+		const cv::Mat& getLayer(const cv::Size& size);
+
+		// layer passed through the Gaussian pyramid down and up
+		const cv::Mat& getSmoothed(const cv::Size& size);
+
+		// binary maps of the smoothed layer
+		const cv::Mat& getAdaptiveThreshold(const cv::Size& size, int block_size, double c);
+		const cv::Mat& getOtsuThreshold(const cv::Size& size);
+
+		// drops all derived images and the filters order, e.g. after the source is modified
+		void reset();
+
+		int getBuiltCount() const { return _built; }
+		int getHitCount() const { return _hits; }
+
+		// bytes used by all derived images
+		size_t getMemoryUsage() const;
+
+	private:
+		struct Layer
+		{
+			cv::Mat image;
+			cv::Mat smoothed;
+			cv::Mat otsu;
+			std::map<std::pair<int, double>, cv::Mat> adaptive;
+		};
+
+		typedef std::map<std::pair<int, int>, Layer> Layers;
+
+		Layer& findLayer(const cv::Size& size);
+		void built();
+
+		const Image& _src;
+		Layers _layers;
+		bool _colors_ready;
+		int _black, _white, _other;
+		std::string _image_class;
+		std::vector<int> _order;
+		int _hits, _built;
+
+		PrefilterContext(const PrefilterContext&);
+		PrefilterContext& operator=(const PrefilterContext&);
+	};
+}
+
+#endif // _prefilter_context_h
@@ -15,31 +15,39 @@
 #include "prefilter_entry.h"
 #include <opencv2/opencv.hpp>
 #include "log_ext.h"
+#include "platform_tools.h"
 #include "prefilter_basic.h"
 #include "filters_list.h"
+#include "filter_statistics.h"
 
 namespace imago
 {
 	namespace PrefilterUtils
 	{
-		bool downscale(cv::Mat& image, int max_dim)
+		bool getDownscaleSize(int width, int height, int max_dim, cv::Size& size)
 		{
-			if (std::max(image.cols, image.rows) > max_dim)
+			if (std::max(width, height) > max_dim)
 			{
-				int src_width = image.cols;	
-				cv::Size size;
-
-				if (image.cols > image.rows)
+				if (width > height)
 				{
 					size.width = max_dim;
-					size.height = imago::round((double)image.rows * ((double)max_dim / image.cols));
+					size.height = imago::round((double)height * ((double)max_dim / width));
 				}
 				else
 				{
 					size.height = max_dim;
-					size.width = imago::round((double)image.cols * ((double)max_dim / image.rows));
+					size.width = imago::round((double)width * ((double)max_dim / height));
 				}
+				return true;
+			}
+			return false; // not required
+		}
 
+		bool downscale(cv::Mat& image, int max_dim)
+		{
+			cv::Size size;
+			if (getDownscaleSize(image.cols, image.rows, max_dim, size))
+			{
 				cv::resize(image, image, size, 0.0, 0.0, cv::INTER_AREA);		
 				return true;
 			}
@@ -68,22 +76,60 @@ namespace imago
 
 	bool prefilterEntrypoint(Settings& vars, Image& output, const Image& src)
 	{
-		logEnterFunction();
+		PrefilterContext context(src);
+		return prefilterEntrypoint(vars, output, context);
+	}
 
-		bool result = false;
+	bool prefilterEntrypoint(Settings& vars, Image& output, PrefilterContext& context)
+	{
+		logEnterFunction();
 
-		output.copy(src);
+		const Image& src = context.getSource();
 		
 		vars.general.ImageWidth = vars.general.OriginalImageWidth = src.getWidth();
 		vars.general.ImageHeight = vars.general.OriginalImageHeight = src.getHeight();
 
 		vars.general.ImageAlreadyBinarized = false;
 		vars.general.FilterIndex = 0;
+
+		// the order is kept for all the later runs on the same source
+		if (context.getFilterOrder().empty())
+		{
+			std::vector<int> order;
+			if (vars.general.AdaptiveFilters && vars.caches.PFilterStatistics != NULL)
+			{
+				std::string image_class = context.getImageClass();
+				getLogExt().append("Image class", image_class);
+				vars.caches.PFilterStatistics->getOrder(image_class, getFiltersList(), order);
+			}
+			else
+			{
+				for (int u = 0; u < (int)getFiltersList().size(); u++)
+					order.push_back(u);
+			}
+			context.setFilterOrder(order);
+		}
 		
-		return applyNextPrefilter(vars, output, src, false);
+		return applyNextPrefilter(vars, output, context, false);
+	}
+
+	std::string getAppliedFilterName(const Settings& vars, const PrefilterContext& context)
+	{
+		const std::vector<int>& order = context.getFilterOrder();
+		if (vars.general.FilterIndex < 0 || vars.general.FilterIndex >= (int)order.size())
+			return "";
+		return getFiltersList()[order[vars.general.FilterIndex]].name;
+	}
+
+	bool isWaitingForEstimations(const Settings& vars, const PrefilterContext& context)
+	{
+		const std::vector<int>& order = context.getFilterOrder();
+		if (vars.general.FilterIndex < 0 || vars.general.FilterIndex >= (int)order.size())
+			return false;
+		return getFiltersList()[order[vars.general.FilterIndex]].uses_estimations;
 	}
 
-	bool applyNextPrefilter(Settings& vars, Image& output, const Image& src, bool iterateNext)
+	bool applyNextPrefilter(Settings& vars, Image& output, PrefilterContext& context, bool iterateNext, bool stopAtEstimations)
 	{
 		logEnterFunction();
 		bool result = false;
@@ -93,24 +139,48 @@ namespace imago
 			vars.general.FilterIndex++;
 		}
 
+		// output may share the source data after an assignment, filters should not change it
+		if (output.data == context.getSource().data)
+		{
+			output.release();
+		}
+
 		FilterEntries filters = getFiltersList();
+		
+		// FilterIndex is the position in the order of the source
+		const std::vector<int>& order = context.getFilterOrder();
+
+		FilterStatistics* statistics = vars.general.AdaptiveFilters ? vars.caches.PFilterStatistics : NULL;
+		std::string image_class;
+		if (statistics != NULL)
+			image_class = context.getImageClass();
 
-		for (; vars.general.FilterIndex < (int)filters.size(); vars.general.FilterIndex++)
+		for (; vars.general.FilterIndex < (int)order.size(); vars.general.FilterIndex++)
 		{
-			output.copy(src);
+			int u = order[vars.general.FilterIndex];
 
-			int& u = vars.general.FilterIndex;
+			if (stopAtEstimations && filters[u].uses_estimations)
+			{
+				getLogExt().append("filter waits for estimations", filters[u].name);
+				return false;
+			}
 
 			getLogExt().append("use filter", filters[u].name);
 
 			if (filters[u].condition != NULL &&
-				filters[u].condition(output) == false)
+				filters[u].condition(context.getSource()) == false)
 			{
 				getLogExt().append("filter condition failed", filters[u].name);
 				continue;
 			}
 
-			if (filters[u].routine(vars, output))
+			// filters fill the output from the context images
+			unsigned int start = platform::TICKS();
+			bool applied = filters[u].routine(vars, context, output);
+			if (statistics != NULL)
+				statistics->recordFilter(image_class, filters[u].name, applied, platform::TICKS() - start);
+
+			if (applied)
 			{
 				getLogExt().append("filter success", filters[u].name);
 				if (!filters[u].update_config_string.empty())
@@ -126,6 +196,15 @@ namespace imago
 			}
 		}
 
+		if (!result)
+		{
+			output.copy(context.getSource());
+		}
+
+		getLogExt().append("Prefilter images built", context.getBuiltCount());
+		getLogExt().append("Prefilter images reused", context.getHitCount());
+		getLogExt().append("Prefilter images memory usage", context.getMemoryUsage());
+
 		return result;
 	}
 }
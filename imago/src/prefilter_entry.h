@@ -16,19 +16,37 @@
 #ifndef _prefilter_entry_h
 #define _prefilter_entry_h
 
+#include <string>
 #include "image.h"
 #include "settings.h"
+#include "prefilter_context.h"
 
 namespace imago
 {
 	// selects first OK prefilter
 	bool prefilterEntrypoint(Settings& vars, Image& output, const Image& src);
+
+	// the same sharing the context images with the next filters and later runs on the same source
+	bool prefilterEntrypoint(Settings& vars, Image& output, PrefilterContext& context);
 	
-	// iterates trough next filters
-	bool applyNextPrefilter(Settings& vars, Image& output, const Image& src, bool iterateNext = true);
+	// iterates trough next filters, output is the source if none of them applies;
+	// with stopAtEstimations returns false before a filter reading the recognition estimations,
+	// FilterIndex stays at it and the next call should not iterate
+	bool applyNextPrefilter(Settings& vars, Image& output, PrefilterContext& context, bool iterateNext = true,
+	                        bool stopAtEstimations = false);
+
+	// the last applyNextPrefilter call has stopped before a filter reading the recognition estimations
+	bool isWaitingForEstimations(const Settings& vars, const PrefilterContext& context);
+
+	// name of the filter applied by the last call, filters are ordered by the image class 
+	// statistics when vars.general.AdaptiveFilters is set
+	std::string getAppliedFilterName(const Settings& vars, const PrefilterContext& context);
 
 	namespace PrefilterUtils
 	{
+		// returns false if image fits max_dim already
+		bool getDownscaleSize(int width, int height, int max_dim, cv::Size& size);
+
 		// returns true if image was modified
 		bool resampleImage(const Settings& vars, Image &image);
 	}
@@ -13,7 +13,11 @@
  ***************************************************************************/
 
 #include "prefilter_retinex.h"
+#include <cfloat>
+#include <cstring>
+#include <algorithm>
 #include <opencv2/opencv.hpp>
+#include <boost/thread.hpp>
 #include "log_ext.h"
 #include "image_utils.h"
 #include "prefilter_basic.h"
@@ -256,18 +260,10 @@ namespace imago
 			return true;
 		}		
 
-		bool prefilterRetinexDownscaleOnly(Settings& vars, Image& raw)
-		{
-			return PrefilterUtils::resampleImage(vars, raw) &&
-				   prefilterRetinexFullsize(vars, raw);
-		}
-
-		bool prefilterRetinexFullsize(Settings& vars, Image& raw)
+		void retinexEnhanceReference(const Settings& vars, Image& raw)
 		{
 			logEnterFunction();
 
-			getLogExt().appendImage("Source image", raw);
-
 			// dimensions should be even for the FFT transform
 			int width = (raw.getWidth() / 2) * 2;
 			int height = (raw.getHeight() / 2) * 2;
@@ -318,6 +314,322 @@ namespace imago
 					raw.getByte(x, y) = c;
 				}
 			}
+		}
+
+		// calls body(stripe, first, last) for stripes of rows [first, last) on the worker threads
+		template <class Body>
+		class RowStripes
+		{
+		public:
+			RowStripes(const Body& body, int stripe, int first, int last) : _body(&body), _stripe(stripe), _first(first), _last(last) {}
+
+			void operator()() const
+			{
+				(*_body)(_stripe, _first, _last);
+			}
+
+			static void run(const Body& body, int rows, int threads)
+			{
+				if (threads > rows)
+					threads = rows;
+
+				if (threads <= 1)
+				{
+					body(0, 0, rows);
+					return;
+				}
+
+				boost::thread_group group;
+				for (int t = 0; t < threads; t++)
+					group.create_thread(RowStripes(body, t, rows * t / threads, rows * (t + 1) / threads));
+				group.join_all();
+			}
+
+		private:
+			const Body* _body;
+			int _stripe, _first, _last;
+		};
+
+		// sum of discrete laplacians thresholded by all the retinex thresholds, a difference adds once per threshold it exceeds
+		struct ThresholdedLaplacianSum
+		{
+			const cv::Mat1f* input;
+			cv::Mat1f* output;
+			std::vector<float> thresholds;
+
+			float weighted(float diff) const
+			{
+				float count = 0.0f;
+				float a = std::fabs(diff);
+				for (size_t k = 0; k < thresholds.size(); k++)
+					count += (a > thresholds[k]) ? 1.0f : 0.0f;
+				return diff * count;
+			}
+
+			void operator()(int, int first, int last) const
+			{
+				const int w = input->cols, h = input->rows;
+				for (int y = first; y < last; y++)
+				{
+					// missing neighbor rows are replaced by the row itself, giving zero differences
+					const float* row = (*input)[y];
+					const float* above = (*input)[y > 0 ? y - 1 : y];
+					const float* below = (*input)[y + 1 < h ? y + 1 : y];
+					float* out = (*output)[y];
+
+					for (int x = 0; x < w; x++)
+						out[x] = weighted(row[x] - above[x]) + weighted(row[x] - below[x]);
+
+					for (int x = 1; x < w; x++)
+						out[x] += weighted(row[x] - row[x - 1]);
+
+					for (int x = 0; x + 1 < w; x++)
+						out[x] += weighted(row[x] - row[x + 1]);
+				}
+			}
+		};
+
+		// solves the Poisson equation in the cosine transform space
+		struct PoissonScale
+		{
+			cv::Mat1f* data;
+			std::vector<float> cosi, cosj;
+			float m2;
+
+			void operator()(int, int first, int last) const
+			{
+				for (int y = first; y < last; y++)
+				{
+					float* row = (*data)[y];
+					const float base = 2.0f - cosj[y];
+					int x = 0;
+					if (y == 0)
+						row[x++] = 0.0f; // the constant component is not defined by the laplacian
+					for (; x < data->cols; x++)
+						row[x] *= m2 / (base - cosi[x]);
+				}
+			}
+		};
+
+		// histogram, sum and range of values
+		struct ContrastStats
+		{
+			int hist[256];
+			double sum;
+			float min_v, max_v;
+
+			void reset()
+			{
+				memset(hist, 0, sizeof(hist));
+				sum = 0.0;
+				min_v = FLT_MAX;
+				max_v = -FLT_MAX;
+			}
+
+			void merge(const ContrastStats& other)
+			{
+				for (int u = 0; u < 256; u++)
+					hist[u] += other.hist[u];
+				sum += other.sum;
+				min_v = std::min(min_v, other.min_v);
+				max_v = std::max(max_v, other.max_v);
+			}
+		};
+
+		// maps values linearly and clamps them when required, collecting statistics of the result for the next iteration
+		struct ContrastRemap
+		{
+			cv::Mat1f* data;
+			double scale, shift;
+			bool clamp;
+			std::vector<ContrastStats>* stats;
+
+			void operator()(int stripe, int first, int last) const
+			{
+				ContrastStats& st = (*stats)[stripe];
+				st.reset();
+				for (int y = first; y < last; y++)
+				{
+					float* row = (*data)[y];
+					double row_sum = 0.0;
+					for (int x = 0; x < data->cols; x++)
+					{
+						float v = (float)(row[x] * scale + shift);
+						if (clamp)
+							v = std::min(std::max(v, 0.0f), 255.0f);
+						row[x] = v;
+						row_sum += v;
+						st.min_v = std::min(st.min_v, v);
+						st.max_v = std::max(st.max_v, v);
+						st.hist[std::min(std::max(imago::round(v), 0), 255)]++;
+					}
+					st.sum += row_sum;
+				}
+			}
+		};
+
+		static void remapContrast(cv::Mat1f& data, double scale, double shift, bool clamp, int threads, ContrastStats& result)
+		{
+			int stripes = std::max(1, std::min(threads, data.rows));
+			std::vector<ContrastStats> stats(stripes);
+			for (int u = 0; u < stripes; u++)
+				stats[u].reset();
+
+			ContrastRemap remap;
+			remap.data = &data;
+			remap.scale = scale;
+			remap.shift = shift;
+			remap.clamp = clamp;
+			remap.stats = &stats;
+			RowStripes<ContrastRemap>::run(remap, data.rows, stripes);
+
+			result.reset();
+			for (int u = 0; u < stripes; u++)
+				result.merge(stats[u]);
+		}
+
+		// linear map of [smin, smax] to [dmin, dmax] like cv::normalize with NORM_MINMAX
+		static void minMaxMapping(double smin, double smax, double dmin, double dmax, double& scale, double& shift)
+		{
+			scale = (smax - smin > DBL_EPSILON) ? (dmax - dmin) / (smax - smin) : 0.0;
+			shift = dmin - smin * scale;
+		}
+
+		// the same iterations as contrastNormalize, but each of them is a single pass over data
+		static void contrastNormalizeFused(cv::Mat1f& data, int contrastNominal, double dropPercentage, int threads)
+		{
+			logEnterFunction();
+
+			const int max_value = 255;
+			const double total = (double)data.rows * data.cols;
+
+			ContrastStats stats;
+			remapContrast(data, 1.0, 0.0, false, threads, stats);
+
+			double scale, shift;
+			minMaxMapping(stats.min_v, stats.max_v, 0, max_value, scale, shift);
+			remapContrast(data, scale, shift, false, threads, stats);
+
+			double prev_value = 0;
+			for (int iters = 0; iters < 10; iters++)
+			{
+				double value = stats.sum / total;
+				if (value > contrastNominal)
+				{
+					getLogExt().append("Average value is OK", value);
+					break;
+				}
+
+				int min_v = 0;
+				int max_v = max_value;
+				{
+					int sum = 0;
+					while (sum < total * dropPercentage && max_v > min_v) 
+					{
+						sum += stats.hist[max_v];
+						max_v--;
+					}
+				}
+				{
+					int sum = 0;
+					while (sum < total * dropPercentage && max_v > min_v) 
+					{
+						sum += stats.hist[min_v];
+						min_v++;
+					}
+				}	
+
+				min_v = -min_v;
+				max_v = max_value + (max_value - max_v);
+				getLogExt().append("Normalize range min", min_v);
+				getLogExt().append("Normalize range max", max_v);
+
+				minMaxMapping(stats.min_v, stats.max_v, min_v, max_v, scale, shift);
+				remapContrast(data, scale, shift, true, threads, stats);
+
+				value = stats.sum / total;
+				if (value > contrastNominal || value < prev_value)
+					break;
+				prev_value = value;
+			}
+		}
+
+		void retinexEnhance(const Settings& vars, Image& raw)
+		{
+			logEnterFunction();
+
+			// dimensions should be even for the cosine transform
+			int width = (raw.getWidth() / 2) * 2;
+			int height = (raw.getHeight() / 2) * 2;
+
+			int threads = vars.general.WorkerThreads;
+			if (threads <= 0)
+				threads = std::max(1, (int)boost::thread::hardware_concurrency());
+
+			cv::Mat1f input;
+			raw(cv::Rect(0, 0, width, height)).convertTo(input, CV_32F);
+
+			// the transforms are linear, so laplacians of all the scales are summed and transformed once
+			cv::Mat1f data(height, width);
+			{
+				ThresholdedLaplacianSum laplacian;
+				laplacian.input = &input;
+				laplacian.output = &data;
+				for (int iteration =  vars.retinex.StartIteration; 
+					     iteration <  vars.retinex.EndIteration; 
+						 iteration += vars.retinex.IterationStep)
+				{
+					laplacian.thresholds.push_back((float)iteration);
+				}
+				getLogExt().append("Scales", laplacian.thresholds.size());
+				RowStripes<ThresholdedLaplacianSum>::run(laplacian, height, threads);
+			}
+			input.release();
+
+			cv::dct(data, data);
+			{
+				PoissonScale poisson;
+				poisson.data = &data;
+				fastFillCosTable(width, poisson.cosi);
+				fastFillCosTable(height, poisson.cosj);
+				poisson.m2 = 1.0f / ((float)width * height) / 2.0f;
+				RowStripes<PoissonScale>::run(poisson, height, threads);
+			}
+			cv::dct(data, data, cv::DCT_INVERSE);
+
+			contrastNormalizeFused(data, vars.retinex.ContrastNominal, vars.retinex.ContrastDropPercentage, threads);
+
+			getLogExt().appendText("Store image data");
+
+			raw.clear();
+			raw.init(width, height);
+			for (int y = 0; y < height; y++)
+			{
+				const float* src = data[y];
+				byte* dst = raw.ptr(y);
+				for (int x = 0; x < width; x++)
+					dst[x] = (byte)std::min(std::max(imago::round(src[x]), 0), 255);
+			}
+		}
+
+		bool prefilterRetinexDownscaleOnly(Settings& vars, PrefilterContext& context, Image& output)
+		{
+			const Image& src = context.getSource();
+			cv::Size size;
+			if (!PrefilterUtils::getDownscaleSize(src.getWidth(), src.getHeight(), vars.csr.RescaleImageDimensions, size))
+				return false;
+
+			ImageUtils::copyMatToImage(context.getLayer(size), output);
+			return prefilterRetinexFullsize(vars, output);
+		}
+
+		bool prefilterRetinexFullsize(Settings& vars, Image& raw)
+		{
+			logEnterFunction();
+
+			getLogExt().appendImage("Source image", raw);
+
+			retinexEnhance(vars, raw);
 
 			getLogExt().appendImage("Retinex-processed image", raw);
 
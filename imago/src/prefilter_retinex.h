@@ -18,14 +18,21 @@
 
 #include "image.h"
 #include "settings.h"
+#include "prefilter_context.h"
 
 namespace imago
 {
 	namespace prefilter_retinex
 	{
 		// filters image using retinex-based approach
-		bool prefilterRetinexDownscaleOnly(Settings& vars, Image& raw);
+		bool prefilterRetinexDownscaleOnly(Settings& vars, PrefilterContext& context, Image& output);
 		bool prefilterRetinexFullsize(Settings& vars, Image& raw);
+
+		// multi-scale retinex with contrast normalization, crops image to even dimensions
+		void retinexEnhance(const Settings& vars, Image& raw);
+
+		// the same with separate transforms for every scale, for comparison
+		void retinexEnhanceReference(const Settings& vars, Image& raw);
 	}
 }
 
@@ -15,22 +15,112 @@
 #include "recognition_distance.h"
 #include <algorithm>
 #include "log_ext.h"
+#include "exception.h"
 #include <float.h>
 
 namespace imago
 {
+	CharacterMask::CharacterMask()
+	{
+		bits[0] = bits[1] = 0;
+	}
+
+	CharacterMask::CharacterMask(const std::string& chars)
+	{
+		bits[0] = bits[1] = 0;
+		for (size_t u = 0; u < chars.size(); u++)
+			add(chars[u]);
+	}
+
+	void CharacterMask::add(char c)
+	{
+		unsigned char v = (unsigned char)c;
+		if (v < 128)
+			bits[v >> 6] |= (qword)1 << (v & 63);
+	}
+
+	bool CharacterMask::contains(char c) const
+	{
+		unsigned char v = (unsigned char)c;
+		return v < 128 && (bits[v >> 6] & ((qword)1 << (v & 63))) != 0;
+	}
+
+	RecognitionDistance::RecognitionDistance()
+	{
+		std::fill(_distance, _distance + SLOTS, DIST_INF);
+	}
+
+	int RecognitionDistance::slot(char c)
+	{
+		unsigned char v = (unsigned char)c;
+		return v < SLOTS ? v : -1;
+	}
+
+	bool RecognitionDistance::empty() const
+	{
+		return _present.bits[0] == 0 && _present.bits[1] == 0;
+	}
+
+	size_t RecognitionDistance::size() const
+	{
+		size_t result = 0;
+		for (int c = 0; c < SLOTS; c++)
+			if (_present.contains((char)c))
+				result++;
+		return result;
+	}
+
+	void RecognitionDistance::clear()
+	{
+		_present = CharacterMask();
+		std::fill(_distance, _distance + SLOTS, DIST_INF);
+	}
+
+	bool RecognitionDistance::has(char c) const
+	{
+		return _present.contains(c);
+	}
+
+	double RecognitionDistance::get(char c) const
+	{
+		return _present.contains(c) ? _distance[slot(c)] : DIST_INF;
+	}
+
+	void RecognitionDistance::set(char c, double dist)
+	{
+		int s = slot(c);
+		if (s < 0)
+			throw ImagoException("Character is out of recognition table range");
+		_distance[s] = dist;
+		_present.add(c);
+	}
+
+	void RecognitionDistance::setMinimum(char c, double dist)
+	{
+		if (!has(c) || dist < get(c))
+			set(c, dist);
+	}
+
+	void RecognitionDistance::filter(const CharacterMask& mask)
+	{
+		for (int w = 0; w < 2; w++)
+			_present.bits[w] &= mask.bits[w];
+	}
+
+	std::map<char, double> RecognitionDistance::toMap() const
+	{
+		std::map<char, double> result;
+		for (int c = 0; c < SLOTS; c++)
+			if (_present.contains((char)c))
+				result[(char)c] = _distance[c];
+		return result;
+	}
 
 	void RecognitionDistance::mergeTables(const RecognitionDistance& second)
 	{
-		for (RecognitionDistance::const_iterator it = second.begin(); it != second.end(); ++it)
-		{
-			if (this->find(it->first) == this->end())
-				(*this)[it->first] = it->second;
-			else
-			{
-				(*this)[it->first] = std::min((*this)[it->first], it->second);
-			}
-		}
+		for (int c = 0; c < SLOTS; c++)
+			if (second._present.contains((char)c))
+				setMinimum((char)c, second._distance[c]);
 	}
 
 	void RecognitionDistance::adjust(double factor, const std::string& sym_set)
@@ -41,29 +131,26 @@ namespace imago
 		getLogExt().append("Distance map adjust for " + sym_set, factor);
 
 		for (size_t u = 0; u < sym_set.size(); u++)
-			if (this->find(sym_set[u]) != this->end())
-				(*this)[sym_set[u]] *= factor;
-	}
-
-	void RecognitionDistance::fillVector(PrVec &out) const
-	{
-		for (RecognitionDistance::const_iterator it = this->begin(); it != this->end(); ++it)
-			out.push_back(std::make_pair(it->first, it->second));
+			if (has(sym_set[u]))
+				_distance[slot(sym_set[u])] *= factor;
 	}
 
 	double RecognitionDistance::getQuality() const
 	{		
 		double min1 = 999.0, min2 = 1000.0;
 	
-		for (RecognitionDistance::const_iterator it = this->begin(); it != this->end(); ++it)
+		for (int c = 0; c < SLOTS; c++)
 		{
-			if (it->second < min1)
+			if (!_present.contains((char)c))
+				continue;
+
+			if (_distance[c] < min1)
 			{
 				min2 = min1;
-				min1 = it->second;
+				min1 = _distance[c];
 			}
-			else if (it->second < min2)
-				min2 = it->second;
+			else if (_distance[c] < min2)
+				min2 = _distance[c];
 		}
 
 		double result = min2 - min1;
@@ -76,19 +163,35 @@ namespace imago
 	std::string RecognitionDistance::getRangedBest(double max_diff) const
 	{
 		std::string result;
-	
-		PrVec temp;
-		fillVector(temp);	
-	
-		if (!temp.empty())
+
+		if (empty())
+			return result;
+
+		double best;
+		char best_char = getBest(&best);
+
+		// characters within range ordered by distance, insertion sort keeps char order for equal distances
+		char chars[SLOTS];
+		int count = 0;
+		for (int c = 0; c < SLOTS; c++)
 		{
-			std::sort(temp.begin(), temp.end(), sortCompareFunction);
-			result = temp[0].first;
-			for (size_t u = 1; u < temp.size(); u++)
-				if (temp[u].second < temp[0].second + max_diff)
-					result += temp[u].first;
+			if (!_present.contains((char)c) || !(_distance[c] < best + max_diff))
+				continue;
+
+			int pos = count++;
+			while (pos > 0 && _distance[c] < _distance[(unsigned char)chars[pos - 1]])
+			{
+				chars[pos] = chars[pos - 1];
+				pos--;
+			}
+			chars[pos] = (char)c;
 		}
 
+		result = best_char;
+		for (int u = 0; u < count; u++)
+			if (chars[u] != best_char)
+				result += chars[u];
+
 		return result;
 	}
 
@@ -96,16 +199,28 @@ namespace imago
 	{
 		double d = DBL_MAX;
 		char result = 0;
-		for (RecognitionDistance::const_iterator it = this->begin(); it != this->end(); ++it)
+		for (int c = 0; c < SLOTS; c++)
 		{
-			if (it->second < d)
+			if (_present.contains((char)c) && _distance[c] < d)
 			{
-				d = it->second;
-				result = it->first;
+				d = _distance[c];
+				result = (char)c;
 			}
 		}
 		if (dist != NULL)
 			*dist = d;
 		return result;
 	}
+
+	bool RecognitionDistance::operator==(const RecognitionDistance& second) const
+	{
+		if (_present.bits[0] != second._present.bits[0] || _present.bits[1] != second._present.bits[1])
+			return false;
+
+		for (int c = 0; c < SLOTS; c++)
+			if (_present.contains((char)c) && _distance[c] != second._distance[c])
+				return false;
+
+		return true;
+	}
 }
@@ -23,38 +23,72 @@
 
 namespace imago
 {
-	class RecognitionDistance : public std::map<char, double>
-	  {
-	  protected:
-		  typedef std::pair<char, double> PrVecItem;
-		  typedef std::vector<PrVecItem> PrVec;
+	/// set of characters as a bitmask, used to restrict recognition results without copying
+	class CharacterMask
+	{
+	public:
+		CharacterMask();
+		CharacterMask(const std::string& chars);
 
-		  void fillVector(PrVec &out) const;
+		void add(char c);
+		bool contains(char c) const;
 
-		  static bool sortCompareFunction(const PrVecItem& i1, const PrVecItem& i2)
-		  {
-			  return i1.second < i2.second;
-		  }
+		qword bits[2];
+	};
 
-	  public:		  
+	/// fixed-size table of distances indexed by character, does not allocate memory
+	class RecognitionDistance
+	{
+	public:
+		/// only 7-bit characters are stored
+		enum { SLOTS = 128 };
 
-		  /// returns best matched symbol and its distance
-		  char getBest(double* dist = NULL) const;
+		RecognitionDistance();
+
+		bool empty() const;
+		size_t size() const;
+		void clear();
+
+		bool has(char c) const;
+
+		/// returns distance for specified char or DIST_INF if it is absent
+		double get(char c) const;
+
+		void set(char c, double dist);
+
+		/// stores dist only if it is better than the present one
+		void setMinimum(char c, double dist);
+
+		/// removes all characters not included into mask
+		void filter(const CharacterMask& mask);
+
+		/// returns ordered table for logging purposes
+		std::map<char, double> toMap() const;
+
+		/// returns best matched symbol and its distance
+		char getBest(double* dist = NULL) const;
 		  
-		  /// returns the difference between two best symbols recognized
-		  double getQuality() const;
+		/// returns the difference between two best symbols recognized
+		double getQuality() const;
 
-		  /// returns best symbol and others differs no more than max_diff
-		  std::string getRangedBest(double max_diff = 0.5) const;
+		/// returns best symbol and others differs no more than max_diff
+		std::string getRangedBest(double max_diff = 0.5) const;
 		  
-		  /// selects best from both tables
-		  void mergeTables(const RecognitionDistance& second);
+		/// selects best from both tables
+		void mergeTables(const RecognitionDistance& second);
+
+		/// multiply distance for specified sym_set by factor
+		void adjust(double factor, const std::string& sym_set);
+
+		bool operator==(const RecognitionDistance& second) const;
+		bool operator!=(const RecognitionDistance& second) const { return !(*this == second); }
 
-		  /// multiply distance for specified sym_set by factor
-		  void adjust(double factor, const std::string& sym_set);
-	  };
+	private:
+		static int slot(char c);
 
-	typedef std::map<qword, RecognitionDistance> RecognitionDistanceCacheType;
+		CharacterMask _present;
+		double _distance[SLOTS];
+	};
 }
 
 #endif // _recognition_distance_h
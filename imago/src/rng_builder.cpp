@@ -0,0 +1,417 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "rng_builder.h"
+#include "vec2d.h"
+
+namespace imago
+{
+	namespace
+	{
+		// Delaunay triangulation by Guibas-Stolfi divide and conquer over quad-edges;
+		// edge reference is quad index * 4 + rotation
+		class DelaunayTriangulation
+		{
+		public:
+			DelaunayTriangulation(const Points2d& points, const IntVector& order) : _points(points), _order(order)
+			{
+				_next.reserve(order.size() * 12);
+				_org.reserve(order.size() * 12);
+				if (order.size() >= 2)
+				{
+					int le, re;
+					_triangulate(0, order.size(), le, re);
+				}
+			}
+
+			// undirected edges between point indices
+			void getEdges(std::vector<IntPair>& edges) const
+			{
+				for (size_t q = 0; q < _deleted.size(); q++)
+				{
+					if (_deleted[q])
+						continue;
+					int a = _org[q * 4], b = _org[q * 4 + 2];
+					edges.push_back(a < b ? IntPair(a, b) : IntPair(b, a));
+				}
+			}
+
+		private:
+			const Points2d& _points;
+			const IntVector& _order;
+			IntVector _next;
+			IntVector _org;
+			std::vector<bool> _deleted;
+
+			static int rot(int e) { return (e & ~3) | ((e + 1) & 3); }
+			static int sym(int e) { return (e & ~3) | ((e + 2) & 3); }
+			static int rotInv(int e) { return (e & ~3) | ((e + 3) & 3); }
+
+			int onext(int e) const { return _next[e]; }
+			int oprev(int e) const { return rot(onext(rot(e))); }
+			int lnext(int e) const { return rot(onext(rotInv(e))); }
+			int rprev(int e) const { return onext(sym(e)); }
+			int org(int e) const { return _org[e]; }
+			int dest(int e) const { return _org[sym(e)]; }
+
+			int makeEdge(int from, int to)
+			{
+				int e = _next.size();
+				_next.push_back(e);
+				_next.push_back(e + 3);
+				_next.push_back(e + 2);
+				_next.push_back(e + 1);
+				_org.push_back(from);
+				_org.push_back(-1);
+				_org.push_back(to);
+				_org.push_back(-1);
+				_deleted.push_back(false);
+				return e;
+			}
+
+			void splice(int a, int b)
+			{
+				int alpha = rot(onext(a)), beta = rot(onext(b));
+				std::swap(_next[a], _next[b]);
+				std::swap(_next[alpha], _next[beta]);
+			}
+
+			int connect(int a, int b)
+			{
+				int e = makeEdge(dest(a), org(b));
+				splice(e, lnext(a));
+				splice(sym(e), b);
+				return e;
+			}
+
+			void deleteEdge(int e)
+			{
+				splice(e, oprev(e));
+				splice(sym(e), oprev(sym(e)));
+				_deleted[e / 4] = true;
+			}
+
+			// orientation is exact for coordinates given with a few fractional bits
+			bool ccw(int a, int b, int c) const
+			{
+				const Vec2d &pa = _points[a], &pb = _points[b], &pc = _points[c];
+				return (pb.x - pa.x) * (pc.y - pa.y) - (pb.y - pa.y) * (pc.x - pa.x) > 0;
+			}
+
+			bool rightOf(int x, int e) const { return ccw(x, dest(e), org(e)); }
+			bool leftOf(int x, int e) const { return ccw(x, org(e), dest(e)); }
+			bool valid(int e, int basel) const { return rightOf(dest(e), basel); }
+
+			// d is strictly inside the circle through counterclockwise a, b, c; results within
+			// the rounding error are treated as cocircular, any choice is Delaunay then
+			bool inCircle(int a, int b, int c, int d) const
+			{
+				const Vec2d &pa = _points[a], &pb = _points[b], &pc = _points[c], &pd = _points[d];
+				double adx = pa.x - pd.x, ady = pa.y - pd.y;
+				double bdx = pb.x - pd.x, bdy = pb.y - pd.y;
+				double cdx = pc.x - pd.x, cdy = pc.y - pd.y;
+				double alift = adx * adx + ady * ady;
+				double blift = bdx * bdx + bdy * bdy;
+				double clift = cdx * cdx + cdy * cdy;
+				double det = alift * (bdx * cdy - cdx * bdy) + blift * (cdx * ady - adx * cdy) + clift * (adx * bdy - bdx * ady);
+				double permanent = alift * (fabs(bdx * cdy) + fabs(cdx * bdy)) + blift * (fabs(cdx * ady) + fabs(adx * cdy)) +
+				                   clift * (fabs(adx * bdy) + fabs(bdx * ady));
+				return det > permanent * 1e-12;
+			}
+
+			// triangulates points _order[lo..hi), le is ccw convex hull edge out of the leftmost
+			// point, re is cw convex hull edge out of the rightmost one
+			void _triangulate(int lo, int hi, int& le, int& re)
+			{
+				int n = hi - lo;
+				if (n == 2)
+				{
+					int a = makeEdge(_order[lo], _order[lo + 1]);
+					le = a;
+					re = sym(a);
+					return;
+				}
+
+				if (n == 3)
+				{
+					int s1 = _order[lo], s2 = _order[lo + 1], s3 = _order[lo + 2];
+					int a = makeEdge(s1, s2);
+					int b = makeEdge(s2, s3);
+					splice(sym(a), b);
+
+					if (ccw(s1, s2, s3))
+					{
+						connect(b, a);
+						le = a;
+						re = sym(b);
+					}
+					else if (ccw(s1, s3, s2))
+					{
+						int c = connect(b, a);
+						le = sym(c);
+						re = c;
+					}
+					else
+					{
+						le = a;
+						re = sym(b);
+					}
+					return;
+				}
+
+				int ldo, ldi, rdi, rdo;
+				int mid = lo + n / 2;
+				_triangulate(lo, mid, ldo, ldi);
+				_triangulate(mid, hi, rdi, rdo);
+
+				// lower common tangent of the halves
+				for (;;)
+				{
+					if (leftOf(org(rdi), ldi))
+						ldi = lnext(ldi);
+					else if (rightOf(org(ldi), rdi))
+						rdi = rprev(rdi);
+					else
+						break;
+				}
+
+				int basel = connect(sym(rdi), ldi);
+				if (org(ldi) == org(ldo))
+					ldo = sym(basel);
+				if (org(rdi) == org(rdo))
+					rdo = basel;
+
+				// merge loop, zipping the halves from bottom to top
+				for (;;)
+				{
+					int lcand = onext(sym(basel));
+					if (valid(lcand, basel))
+					{
+						while (inCircle(dest(basel), org(basel), dest(lcand), dest(onext(lcand))))
+						{
+							int t = onext(lcand);
+							deleteEdge(lcand);
+							lcand = t;
+						}
+					}
+
+					int rcand = oprev(basel);
+					if (valid(rcand, basel))
+					{
+						while (inCircle(dest(basel), org(basel), dest(rcand), dest(oprev(rcand))))
+						{
+							int t = oprev(rcand);
+							deleteEdge(rcand);
+							rcand = t;
+						}
+					}
+
+					bool lvalid = valid(lcand, basel), rvalid = valid(rcand, basel);
+					if (!lvalid && !rvalid)
+						break;
+
+					if (!lvalid || (rvalid && inCircle(dest(lcand), org(lcand), org(rcand), dest(rcand))))
+						basel = connect(rcand, sym(basel));
+					else
+						basel = connect(sym(basel), sym(lcand));
+				}
+
+				le = ldo;
+				re = rdo;
+			}
+		};
+
+		struct PointOrder
+		{
+			const Points2d* points;
+
+			bool operator()(int a, int b) const
+			{
+				const Vec2d &pa = (*points)[a], &pb = (*points)[b];
+				if (pa.x != pb.x)
+					return pa.x < pb.x;
+				if (pa.y != pb.y)
+					return pa.y < pb.y;
+				return a < b;
+			}
+		};
+
+		bool samePoint(const Vec2d& a, const Vec2d& b)
+		{
+			return a.x == b.x && a.y == b.y;
+		}
+
+		// buckets of point indices for the lune emptiness test
+		class PointGrid
+		{
+		public:
+			PointGrid(const Points2d& points) : _points(points)
+			{
+				_minX = _maxX = points[0].x;
+				_minY = _maxY = points[0].y;
+				for (size_t u = 1; u < points.size(); u++)
+				{
+					_minX = std::min(_minX, points[u].x);
+					_maxX = std::max(_maxX, points[u].x);
+					_minY = std::min(_minY, points[u].y);
+					_maxY = std::max(_maxY, points[u].y);
+				}
+
+				_side = std::max(1, (int)sqrt((double)points.size()));
+				_cellW = std::max((_maxX - _minX) / _side, 1e-9);
+				_cellH = std::max((_maxY - _minY) / _side, 1e-9);
+				_cells.resize(_side * _side);
+				for (size_t u = 0; u < points.size(); u++)
+					_cells[_cellY(points[u].y) * _side + _cellX(points[u].x)].push_back(u);
+			}
+
+			// true if some k has d > max(d(i,k), d(k,j)), the test of RNGBuilder::buildEdgesReference
+			bool luneOccupied(int i, int j, double d) const
+			{
+				const Vec2d &pi = _points[i], &pj = _points[j];
+				int cx1 = _cellX(std::max(pi.x, pj.x) - d), cx2 = _cellX(std::min(pi.x, pj.x) + d);
+				int cy1 = _cellY(std::max(pi.y, pj.y) - d), cy2 = _cellY(std::min(pi.y, pj.y) + d);
+
+				for (int cy = cy1; cy <= cy2; cy++)
+					for (int cx = cx1; cx <= cx2; cx++)
+					{
+						const IntVector& cell = _cells[cy * _side + cx];
+						for (size_t u = 0; u < cell.size(); u++)
+						{
+							int k = cell[u];
+							if (k != i && k != j && d > std::max(Vec2d::distance(pi, _points[k]), Vec2d::distance(_points[k], pj)))
+								return true;
+						}
+					}
+				return false;
+			}
+
+		private:
+			const Points2d& _points;
+			double _minX, _maxX, _minY, _maxY, _cellW, _cellH;
+			int _side;
+			std::vector<IntVector> _cells;
+
+			int _cellX(double x) const
+			{
+				int c = (int)floor((x - _minX) / _cellW);
+				return std::min(std::max(c, 0), _side - 1);
+			}
+
+			int _cellY(double y) const
+			{
+				int c = (int)floor((y - _minY) / _cellH);
+				return std::min(std::max(c, 0), _side - 1);
+			}
+		};
+	}
+
+	void RNGBuilder::buildEdges( const Points2d &points, std::vector<IntPair> &edges )
+	{
+		edges.clear();
+		int n = points.size();
+		if (n < 2)
+			return;
+
+		IntVector order(n);
+		for (int i = 0; i < n; i++)
+			order[i] = i;
+		PointOrder cmp;
+		cmp.points = &points;
+		std::sort(order.begin(), order.end(), cmp);
+
+		// coincident points are triangulated once; every one of them is connected
+		// to each other and gets the edges of its representative
+		IntVector unique, group_of(n), group_start;
+		for (int u = 0; u < n; u++)
+		{
+			if (u == 0 || !samePoint(points[order[u]], points[order[u - 1]]))
+			{
+				group_start.push_back(u);
+				unique.push_back(order[u]);
+			}
+			group_of[order[u]] = group_start.size() - 1;
+		}
+		group_start.push_back(n);
+
+		DelaunayTriangulation triangulation(points, unique);
+		std::vector<IntPair> candidates;
+		triangulation.getEdges(candidates);
+
+		PointGrid grid(points);
+		for (size_t u = 0; u < candidates.size(); u++)
+		{
+			int i = candidates[u].first, j = candidates[u].second;
+			if (grid.luneOccupied(i, j, Vec2d::distance(points[i], points[j])))
+				continue;
+
+			int gi = group_of[i], gj = group_of[j];
+			for (int a = group_start[gi]; a < group_start[gi + 1]; a++)
+				for (int b = group_start[gj]; b < group_start[gj + 1]; b++)
+				{
+					int pa = order[a], pb = order[b];
+					edges.push_back(pa < pb ? IntPair(pa, pb) : IntPair(pb, pa));
+				}
+		}
+
+		for (size_t g = 0; g + 1 < group_start.size(); g++)
+			for (int a = group_start[g]; a < group_start[g + 1]; a++)
+				for (int b = a + 1; b < group_start[g + 1]; b++)
+				{
+					int pa = order[a], pb = order[b];
+					edges.push_back(pa < pb ? IntPair(pa, pb) : IntPair(pb, pa));
+				}
+
+		std::sort(edges.begin(), edges.end());
+	}
+
+	void RNGBuilder::buildEdgesReference( const Points2d &points, std::vector<IntPair> &edges )
+	{
+		edges.clear();
+		int n = points.size();
+		DoubleVector distances(n * n, 0);
+
+		for (int i = 0; i < n; i++)
+			for (int j = 0; j < n; j++)
+				distances[i + j * n] = Vec2d::distance(points[i], points[j]);
+
+		for (int i = 0; i < n; i++)
+		{
+			for (int j = i + 1; j < n; j++)
+			{
+				bool add_edge = true;
+				double d = distances[i + j * n];
+
+				for (int k = 0; k < n; k++)
+				{
+					if (k != i && k != j)
+					{
+						if (d > std::max(distances[i + k * n], distances[k + j * n]))
+						{
+							add_edge = false;
+							break;
+						}
+					}
+				}
+
+				if (add_edge)
+					edges.push_back(IntPair(i, j));
+			}
+		}
+	}
+}
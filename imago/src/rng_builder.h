@@ -20,14 +20,20 @@
 #include "boost/property_map/property_map.hpp"
 #include "boost/graph/adjacency_list.hpp"
 
+#include <vector>
+
 #include "stl_fwd.h"
 #include "comdef.h"
+#include "vec2d.h"
+#include "log_ext.h"
 
 namespace imago
 {
    class RNGBuilder
    {
    public:
+      // adds edges of relative neighborhood graph of vertex positions: vertices i and j are
+      // connected unless some k satisfies d(i,j) > max(d(i,k), d(k,j))
       template <class EuclideanGraph>
       static void build( EuclideanGraph &g )
       {
@@ -46,61 +52,41 @@ namespace imago
 
          std::vector<typename boost::graph_traits<
                      EuclideanGraph>::vertex_descriptor> ind2vert(n);
-         DoubleVector distances(n * n, 0);
+         Points2d points(n);
 
          BGL_FORALL_VERTICES_T(v, g, EuclideanGraph)
-            ind2vert[vert2ind[v]] = v;
-
-         for (int i = 0; i < n; i++)
          {
-            for (int j = 0; j < n; j++)
-            {
-               distances[i + j * n] = Vec2d::distance(positions[ind2vert[i]],
-                                                      positions[ind2vert[j]]);
-            }
+            ind2vert[vert2ind[v]] = v;
+            points[vert2ind[v]] = positions[v];
          }
 
-         for (int i = 0; i < n; i++)
+         std::vector<IntPair> edges;
+         buildEdges(points, edges);
+
+         for (size_t u = 0; u < edges.size(); u++)
          {
-            for (int j = 0; j < n; j++)
+            int i = edges[u].first, j = edges[u].second;
+            bool isAdded;
+            typename boost::graph_traits<EuclideanGraph>::edge_descriptor e;
+
+            boost::tie(e, isAdded) = 
+            boost::add_edge(ind2vert[i], ind2vert[j], g);
+
+            if (!isAdded)
             {
-               if (i != j)
-               {
-                  bool add_edge = true;
-                  double d = distances[i + j * n];
-
-                  for (int k = 0; k < n; k++)
-                  {
-                     if (k != i && k != j)
-                     {
-                        if (d > std::max(distances[i + k * n],
-                                         distances[k + j * n]))
-                        {
-                           add_edge = false;
-                           break;
-                        }
-                     }
-                  }
-
-                  if (add_edge)
-                  {
-                     bool isAdded;
-                     typename boost::graph_traits<EuclideanGraph>::edge_descriptor e;
-
-                     boost::tie(e, isAdded) = 
-                     boost::add_edge(ind2vert[i], ind2vert[j], g);
-
-                     if (!isAdded)
-					 {
-						 getLogExt().appendText("Warning: <RNG::build> edge is not added");
-					 }
-
-                     weights[e] = distances[i + j * n];
-                  }
-               }
+               getLogExt().appendText("Warning: <RNG::build> edge is not added");
             }
+
+            weights[e] = Vec2d::distance(points[i], points[j]);
          }
       }
+
+      // RNG edges as pairs (i, j), i < j, ordered by i then j; candidates are taken
+      // from Delaunay triangulation, which contains RNG
+      static void buildEdges( const Points2d &points, std::vector<IntPair> &edges );
+
+      // the same by checking every triple of points, O(n^3)
+      static void buildEdgesReference( const Points2d &points, std::vector<IntPair> &edges );
    };
 }
 
@@ -35,6 +35,7 @@ Segment::Segment()
 void Segment::copy( const Segment &s, bool copy_all )
 {
 	Image::copy(s);
+	invalidateFeatures();
 	if (copy_all)
 	{
 		_x = s._x;
@@ -132,9 +133,20 @@ double Segment::getDensity()
 }
 
 
+void Segment::invalidateFeatures()
+{
+   _density = _ratio = -1;
+   _features.valid = 0;
+   _features.endpoints.clear();
+   _features.boundary.clear();
+   _features.thinned.clear();
+}
+
 void Segment::splitVert(int x, Segment &left, Segment &right) const
 {
    Image::splitVert(x, left, right);
+   left.invalidateFeatures();
+   right.invalidateFeatures();
    
    left._x = _x;
    right._x = _x + x;
@@ -146,6 +158,7 @@ void Segment::crop()
    int l = 0, t = 0;
 
    Image::crop(-1,-1,-1,-1,&l,&t);
+   invalidateFeatures();
    
    _x += l;
    _y += t;   
@@ -155,6 +168,7 @@ void Segment::rotate90()
 {
    Image::rotate90();
    std::swap(_x, _y);
+   invalidateFeatures();
 }
 
 Segment::~Segment()
@@ -16,6 +16,8 @@
 #ifndef _segment_h
 #define _segment_h
 
+#include <vector>
+#include "stl_fwd.h"
 #include "vec2d.h"
 #include "image.h"
 
@@ -23,6 +25,48 @@ namespace imago
 {
    class Rectangle;
 
+   // features computed by SegmentTools on first request and kept until the segment changes
+   struct SegmentFeatures
+   {
+      enum Kind
+      {
+         FilledCount = 1,
+         RealHeight = 2,
+         Endpoints = 4,
+         HuMoments = 8,
+         Thinned = 16,
+         Boundary = 32
+      };
+
+      int valid;
+      int filledCount;
+      int realHeight;
+      Points2i endpoints;
+      Points2i boundary;
+      double hu[7];
+      Image thinned;
+
+      // statistics: features calculated and requests served from the cache
+      int computed;
+      int reused;
+
+      SegmentFeatures() : valid(0), filledCount(0), realHeight(0), computed(0), reused(0) { }
+
+      bool has( Kind kind )
+      {
+         if ((valid & kind) == 0)
+            return false;
+         reused++;
+         return true;
+      }
+
+      void store( Kind kind )
+      {
+         valid |= kind;
+         computed++;
+      }
+   };
+
    class Segment : public Image
    {
    public:
@@ -31,6 +75,7 @@ namespace imago
 	  Segment( int width, int height, int x, int y ) : Image(width, height)
 	  {
 		  _x = x; _y = y;
+		  _density = _ratio = -1;
 	  }
 
 	  Segment( const Segment &other)
@@ -41,7 +86,7 @@ namespace imago
 	  virtual ~Segment();
 
       void copy( const Segment &s, bool copy_all = true );	  
-	  void copy( const Image &i) { Image::copy(i); }
+	  void copy( const Image &i) { Image::copy(i); invalidateFeatures(); }
 
       int getX() const;
       int getY() const;
@@ -61,11 +106,16 @@ namespace imago
 
       double getRatio() const;
       double getDensity() const;
+
+      // cache of the features, pixels changed in place through getByte() require invalidateFeatures()
+      SegmentFeatures &getFeatures() const { return _features; }
+      void invalidateFeatures();
   
    private:
       int _x, _y;
       double _ratio;
       double _density;
+      mutable SegmentFeatures _features;
    };
 }
 
@@ -0,0 +1,58 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "segment_arena.h"
+
+namespace imago
+{
+	SegmentArena::~SegmentArena()
+	{
+		reset();
+	}
+
+	Segment* SegmentArena::create()
+	{
+		_segments.push_back(Segment());
+		return &_segments.back();
+	}
+
+	Segment* SegmentArena::adopt(Segment* seg)
+	{
+		_adopted.push_back(seg);
+		return seg;
+	}
+
+	void SegmentArena::getFeatureStats(int& computed, int& reused) const
+	{
+		computed = reused = 0;
+		for (std::deque<Segment>::const_iterator it = _segments.begin(); it != _segments.end(); ++it)
+		{
+			computed += it->getFeatures().computed;
+			reused += it->getFeatures().reused;
+		}
+		for (size_t u = 0; u < _adopted.size(); u++)
+		{
+			computed += _adopted[u]->getFeatures().computed;
+			reused += _adopted[u]->getFeatures().reused;
+		}
+	}
+
+	void SegmentArena::reset()
+	{
+		_segments.clear();
+		for (size_t u = 0; u < _adopted.size(); u++)
+			delete _adopted[u];
+		_adopted.clear();
+	}
+}
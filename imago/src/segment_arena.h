@@ -0,0 +1,61 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _segment_arena_h
+#define _segment_arena_h
+
+#include <deque>
+#include <vector>
+#include "segment.h"
+
+namespace imago
+{
+	// owns all segments of one recognition pass, they are released together by reset()
+	class SegmentArena
+	{
+	public:
+		SegmentArena() {}
+		~SegmentArena();
+
+		// returns new empty segment owned by arena
+		Segment* create();
+		
+		// takes ownership of segment allocated by new (e.g. by Segmentator::segmentate)
+		Segment* adopt(Segment* seg);
+
+		template <class Container> void adopt(const Container& segments)
+		{
+			for (typename Container::const_iterator it = segments.begin(); it != segments.end(); ++it)
+				adopt(*it);
+		}
+
+		// releases all the segments, pointers become invalid
+		void reset();
+
+		size_t size() const { return _segments.size() + _adopted.size(); }
+
+		// sums feature cache statistics of the owned segments
+		void getFeatureStats(int& computed, int& reused) const;
+
+	private:
+		std::deque<Segment> _segments; // push_back keeps addresses of the elements
+		std::vector<Segment*> _adopted;
+
+		SegmentArena(const SegmentArena&);
+		SegmentArena& operator=(const SegmentArena&);
+	};
+}
+
+#endif // _segment_arena_h
@@ -0,0 +1,180 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include <algorithm>
+#include "segment_index.h"
+#include "segment.h"
+#include "exception.h"
+
+namespace imago
+{
+	SegmentIndex::SegmentIndex(int width, int height, int cell_size)
+	{
+		if (width <= 0 || height <= 0)
+			throw ImagoException("Empty area for segment index");
+
+		_cellSize = std::max(cell_size, 8);
+		_cols = (width + _cellSize - 1) / _cellSize;
+		_rows = (height + _cellSize - 1) / _cellSize;
+		_cells.resize(_cols * _rows);
+	}
+
+	int SegmentIndex::_cellX(int x) const
+	{
+		if (x < 0)
+			return 0;
+		return std::min(x / _cellSize, _cols - 1);
+	}
+
+	int SegmentIndex::_cellY(int y) const
+	{
+		if (y < 0)
+			return 0;
+		return std::min(y / _cellSize, _rows - 1);
+	}
+
+	void SegmentIndex::insert(Segment* seg)
+	{
+		if (_lookup.find(seg) != _lookup.end())
+			remove(seg);
+
+		Entry e;
+		e.seg = seg;
+		e.rect = seg->getRectangle();
+		e.center = seg->getCenter();
+		e.cx1 = _cellX(e.rect.x1());
+		e.cy1 = _cellY(e.rect.y1());
+		e.cx2 = _cellX(e.rect.x2() - 1);
+		e.cy2 = _cellY(e.rect.y2() - 1);
+		e.alive = true;
+
+		int id = _entries.size();
+		_entries.push_back(e);
+		_lookup[seg] = id;
+
+		for (int cy = e.cy1; cy <= e.cy2; cy++)
+			for (int cx = e.cx1; cx <= e.cx2; cx++)
+				_cells[cy * _cols + cx].push_back(id);
+	}
+
+	void SegmentIndex::remove(Segment* seg)
+	{
+		std::map<const Segment*, int>::iterator it = _lookup.find(seg);
+		if (it == _lookup.end())
+			return;
+
+		int id = it->second;
+		Entry& e = _entries[id];
+		for (int cy = e.cy1; cy <= e.cy2; cy++)
+			for (int cx = e.cx1; cx <= e.cx2; cx++)
+			{
+				IntVector& cell = _cells[cy * _cols + cx];
+				cell.erase(std::find(cell.begin(), cell.end(), id));
+			}
+
+		e.alive = false;
+		_lookup.erase(it);
+	}
+
+	void SegmentIndex::clear()
+	{
+		for (size_t u = 0; u < _cells.size(); u++)
+			_cells[u].clear();
+		_entries.clear();
+		_lookup.clear();
+	}
+
+	void SegmentIndex::queryRect(const Rectangle& rect, std::vector<Segment*>& result) const
+	{
+		result.clear();
+		if (rect.width <= 0 || rect.height <= 0)
+			return;
+
+		int qx1 = _cellX(rect.x1()), qy1 = _cellY(rect.y1());
+		int qx2 = _cellX(rect.x2() - 1), qy2 = _cellY(rect.y2() - 1);
+
+		IntVector found;
+		for (int cy = qy1; cy <= qy2; cy++)
+			for (int cx = qx1; cx <= qx2; cx++)
+			{
+				const IntVector& cell = _cells[cy * _cols + cx];
+				for (size_t u = 0; u < cell.size(); u++)
+				{
+					const Entry& e = _entries[cell[u]];
+					// entry spanning several cells is reported by the first common cell only
+					if (cx != std::max(e.cx1, qx1) || cy != std::max(e.cy1, qy1))
+						continue;
+					if (e.rect.x1() < rect.x2() && rect.x1() < e.rect.x2() &&
+					    e.rect.y1() < rect.y2() && rect.y1() < e.rect.y2())
+						found.push_back(cell[u]);
+				}
+			}
+
+		std::sort(found.begin(), found.end());
+		for (size_t u = 0; u < found.size(); u++)
+			result.push_back(_entries[found[u]].seg);
+	}
+
+	void SegmentIndex::queryNearest(const Vec2i& point, size_t k, std::vector<Segment*>& result) const
+	{
+		result.clear();
+		if (k == 0 || _lookup.empty())
+			return;
+
+		typedef std::pair<double, int> Candidate; // distance and entry id
+		std::vector<Candidate> candidates;
+
+		int px = _cellX(point.x), py = _cellY(point.y);
+		int max_ring = std::max(_cols, _rows);
+
+		for (int r = 0; r <= max_ring; r++)
+		{
+			for (int cy = py - r; cy <= py + r; cy++)
+			{
+				if (cy < 0 || cy >= _rows)
+					continue;
+
+				// inner rows of the ring have only two cells
+				int step = (cy == py - r || cy == py + r) ? 1 : std::max(2 * r, 1);
+				for (int cx = px - r; cx <= px + r; cx += step)
+				{
+					if (cx < 0 || cx >= _cols)
+						continue;
+
+					const IntVector& cell = _cells[cy * _cols + cx];
+					for (size_t u = 0; u < cell.size(); u++)
+					{
+						const Entry& e = _entries[cell[u]];
+						// every entry is taken once from the cell of its center
+						if (_cellX(e.center.x) != cx || _cellY(e.center.y) != cy)
+							continue;
+						candidates.push_back(Candidate(Vec2i::distance(point, e.center), cell[u]));
+					}
+				}
+			}
+
+			// centers in the cells outside of the ring are farther than r cells
+			if (candidates.size() >= k)
+			{
+				std::nth_element(candidates.begin(), candidates.begin() + (k - 1), candidates.end());
+				if (candidates[k - 1].first <= (double)r * _cellSize)
+					break;
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end());
+		for (size_t u = 0; u < candidates.size() && u < k; u++)
+			result.push_back(_entries[candidates[u].second].seg);
+	}
+}
@@ -0,0 +1,79 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _segment_index_h
+#define _segment_index_h
+
+#include <vector>
+#include <map>
+#include "stl_fwd.h"
+#include "rectangle.h"
+#include "vec2d.h"
+
+namespace imago
+{
+	class Segment;
+
+	// uniform grid over segment bounding rectangles for proximity queries,
+	// results are returned in the order the segments were inserted
+	class SegmentIndex
+	{
+	public:
+		// grid covers [0, width) x [0, height), segments outside are kept in the border cells
+		SegmentIndex(int width, int height, int cell_size);
+
+		void insert(Segment* seg);
+
+		template <class Iterator> void insert(Iterator first, Iterator last)
+		{
+			for (; first != last; ++first)
+				insert(*first);
+		}
+
+		// segment position or size should not change while it is indexed, remove and insert it again
+		void remove(Segment* seg);
+
+		void clear();
+
+		size_t size() const { return _lookup.size(); }
+
+		// segments whose bounding rectangle intersects rect (both are treated as half-open)
+		void queryRect(const Rectangle& rect, std::vector<Segment*>& result) const;
+
+		// up to k segments with the nearest centers, ordered by distance
+		void queryNearest(const Vec2i& point, size_t k, std::vector<Segment*>& result) const;
+
+	private:
+		struct Entry
+		{
+			Segment* seg;
+			Rectangle rect;
+			Vec2i center;
+			int cx1, cy1, cx2, cy2; // covered cells, inclusive
+			bool alive;
+		};
+
+		int _cellSize;
+		int _cols, _rows;
+		std::vector<Entry> _entries;
+		std::vector<IntVector> _cells;
+		std::map<const Segment*, int> _lookup;
+
+		int _cellX(int x) const;
+		int _cellY(int y) const;
+	};
+}
+
+#endif // _segment_index_h
@@ -0,0 +1,99 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "segment_runs.h"
+#include <algorithm>
+#include <string.h>
+#include "segment.h"
+#include "exception.h"
+
+namespace imago
+{
+	SegmentRuns::SegmentRuns() : _x(0), _y(0), _width(0), _height(0), _filled(0), _rows(1, 0)
+	{
+	}
+
+	SegmentRuns::SegmentRuns(const Segment& seg)
+	{
+		assign(seg);
+	}
+
+	void SegmentRuns::assign(const Segment& seg)
+	{
+		if (seg.getWidth() > 0xFFFF)
+			throw ImagoException("Segment is too wide for run storage");
+
+		_x = seg.getX();
+		_y = seg.getY();
+		_width = seg.getWidth();
+		_height = seg.getHeight();
+		_filled = 0;
+		_runs.clear();
+		_rows.assign(_height + 1, 0);
+
+		for (int y = 0; y < _height; y++)
+		{
+			_rows[y] = (int)_runs.size();
+			const byte* row = seg.ptr(y);
+			for (int x = 0; x < _width; x++)
+			{
+				if (row[x] != 0)
+					continue;
+
+				Run run;
+				run.x1 = (unsigned short)x;
+				while (x + 1 < _width && row[x + 1] == 0)
+					x++;
+				run.x2 = (unsigned short)x;
+				_runs.push_back(run);
+				_filled += run.x2 - run.x1 + 1;
+			}
+		}
+		_rows[_height] = (int)_runs.size();
+	}
+
+	void SegmentRuns::unpack(Segment& seg) const
+	{
+		seg.init(_width, _height);
+		seg.fillWhite();
+		seg.getX() = _x;
+		seg.getY() = _y;
+
+		for (int y = 0; y < _height; y++)
+		{
+			byte* row = seg.ptr(y);
+			for (const Run* run = getRowBegin(y); run != getRowEnd(y); ++run)
+				memset(row + run->x1, 0, run->x2 - run->x1 + 1);
+		}
+	}
+
+	static bool runEndsBefore(const SegmentRuns::Run& run, int x)
+	{
+		return run.x2 < x;
+	}
+
+	bool SegmentRuns::isFilled(int x, int y) const
+	{
+		if (x < 0 || y < 0 || x >= _width || y >= _height)
+			return false;
+
+		const Run* run = std::lower_bound(getRowBegin(y), getRowEnd(y), x, runEndsBefore);
+		return run != getRowEnd(y) && run->x1 <= x;
+	}
+
+	size_t SegmentRuns::getMemoryUsage() const
+	{
+		return sizeof(*this) + _runs.capacity() * sizeof(Run) + _rows.capacity() * sizeof(int);
+	}
+}
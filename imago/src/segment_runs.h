@@ -0,0 +1,71 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _segment_runs_h
+#define _segment_runs_h
+
+#include <vector>
+#include "comdef.h"
+#include "stl_fwd.h"
+#include "rectangle.h"
+
+namespace imago
+{
+	class Segment;
+
+	// compact segment storage: black pixels are kept as horizontal runs grouped by rows,
+	// other pixel values are treated as white
+	class SegmentRuns
+	{
+	public:
+		SegmentRuns();
+		explicit SegmentRuns(const Segment& seg);
+
+		void assign(const Segment& seg);
+
+		// restores dense segment with the same position
+		void unpack(Segment& seg) const;
+
+		int getX() const { return _x; }
+		int getY() const { return _y; }
+		int getWidth() const { return _width; }
+		int getHeight() const { return _height; }
+		Rectangle getRectangle() const { return Rectangle(_x, _y, _width, _height); }
+
+		bool isFilled(int x, int y) const;
+		byte getByte(int x, int y) const { return isFilled(x, y) ? 0 : 255; }
+
+		// horizontal run, x2 is inclusive, coordinates are relative to segment
+		struct Run
+		{
+			unsigned short x1, x2;
+		};
+
+		// runs of row y are [getRowBegin(y), getRowEnd(y)), ordered by x
+		const Run* getRowBegin(int y) const { return _runs.empty() ? NULL : &_runs[0] + _rows[y]; }
+		const Run* getRowEnd(int y) const { return _runs.empty() ? NULL : &_runs[0] + _rows[y + 1]; }
+
+		int getFilledCount() const { return _filled; }
+		size_t getMemoryUsage() const;
+
+	private:
+		int _x, _y, _width, _height;
+		int _filled;
+		std::vector<Run> _runs;
+		std::vector<int> _rows; // _height + 1 offsets into _runs
+	};
+}
+
+#endif // _segment_runs_h
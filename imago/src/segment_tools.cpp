@@ -17,8 +17,11 @@
 #include "image.h"
 #include "image_draw_utils.h"
 #include "thin_filter2.h"
+#include <algorithm>
 #include <queue>
 #include <float.h>
+#include <climits>
+#include <cmath>
 
 namespace imago
 {
@@ -40,21 +43,158 @@ namespace imago
 
 	int SegmentTools::getFilledCount(const Segment& seg)
 	{
-		int result = 0;
-		for (int y = 0; y < seg.getHeight(); y++)		
+		SegmentFeatures& features = seg.getFeatures();
+		if (!features.has(SegmentFeatures::FilledCount))
 		{
-			for (int x = 0; x < seg.getWidth(); x++)
+			int result = 0;
+			for (int y = 0; y < seg.getHeight(); y++)		
 			{
-				if (seg.getByte(x,y) == 0) // 0 = black
+				for (int x = 0; x < seg.getWidth(); x++)
 				{
-					result++;
+					if (seg.getByte(x,y) == 0) // 0 = black
+					{
+						result++;
+					}
 				}
 			}
+			features.filledCount = result;
+			features.store(SegmentFeatures::FilledCount);
+		}
+		return features.filledCount;
+	}
+
+	const Points2i& SegmentTools::getBoundary(const Segment& seg)
+	{
+		SegmentFeatures& features = seg.getFeatures();
+		if (!features.has(SegmentFeatures::Boundary))
+		{
+			int w = seg.getWidth(), h = seg.getHeight();
+			features.boundary.clear();
+			for (int x = 0; x < w; x++)
+				for (int y = 0; y < h; y++)
+				{
+					if (seg.getByte(x,y) != 0)
+						continue;
+					if (x == 0 || y == 0 || x == w - 1 || y == h - 1 ||
+						seg.getByte(x - 1, y) != 0 || seg.getByte(x + 1, y) != 0 ||
+						seg.getByte(x, y - 1) != 0 || seg.getByte(x, y + 1) != 0)
+						features.boundary.push_back(Vec2i(x,y));
+				}
+			features.store(SegmentFeatures::Boundary);
+		}
+		return features.boundary;
+	}
+
+	double SegmentTools::getDistanceLowerBound(const Segment& seg1, const Segment& seg2, DistanceType type)
+	{
+		// gaps between inclusive pixel ranges of the rectangles
+		int gap_x = std::max(0, std::max(seg1.getX() - (seg2.getX() + seg2.getWidth() - 1), 
+		                                 seg2.getX() - (seg1.getX() + seg1.getWidth() - 1)));
+		int gap_y = std::max(0, std::max(seg1.getY() - (seg2.getY() + seg2.getHeight() - 1), 
+		                                 seg2.getY() - (seg1.getY() + seg1.getHeight() - 1)));
+		if (type == dtDeltaX)
+			return gap_x;
+		if (type == dtDeltaY)
+			return gap_y;
+		return Vec2i::distance(Vec2i(gap_x, gap_y), Vec2i(0, 0));
+	}
+
+	// minimal difference between values of two sorted sequences
+	static int minimalGap(const IntVector& a, const IntVector& b)
+	{
+		int result = INT_MAX;
+		size_t i = 0, j = 0;
+		while (i < a.size() && j < b.size())
+		{
+			result = std::min(result, absolute(a[i] - b[j]));
+			if (a[i] < b[j])
+				i++;
+			else
+				j++;
 		}
 		return result;
 	}
 
+	// occupied global columns (by_x) or rows of segment, sorted
+	static void getProjection(const Segment& seg, bool by_x, IntVector& result)
+	{
+		// every filled column and row has a boundary pixel
+		const Points2i& boundary = SegmentTools::getBoundary(seg);
+		result.clear();
+		for (size_t u = 0; u < boundary.size(); u++)
+			result.push_back(by_x ? boundary[u].x + seg.getX() : boundary[u].y + seg.getY());
+		if (!by_x)
+			std::sort(result.begin(), result.end());
+		result.erase(std::unique(result.begin(), result.end()), result.end());
+	}
+
+	static bool haveCommonPixel(const Segment& seg1, const Segment& seg2)
+	{
+		int x1 = std::max(seg1.getX(), seg2.getX()), x2 = std::min(seg1.getX() + seg1.getWidth(), seg2.getX() + seg2.getWidth());
+		int y1 = std::max(seg1.getY(), seg2.getY()), y2 = std::min(seg1.getY() + seg1.getHeight(), seg2.getY() + seg2.getHeight());
+		for (int y = y1; y < y2; y++)
+			for (int x = x1; x < x2; x++)
+				if (seg1.getByte(x - seg1.getX(), y - seg1.getY()) == 0 && seg2.getByte(x - seg2.getX(), y - seg2.getY()) == 0)
+					return true;
+		return false;
+	}
+
 	double SegmentTools::getRealDistance(const Segment& seg1, const Segment& seg2, DistanceType type)
+	{
+		const Points2i& p1 = getBoundary(seg1);
+		const Points2i& p2 = getBoundary(seg2);
+		if (p1.empty() || p2.empty())
+			return DBL_MAX;
+
+		if (type == dtDeltaX || type == dtDeltaY)
+		{
+			IntVector proj1, proj2;
+			getProjection(seg1, type == dtDeltaX, proj1);
+			getProjection(seg2, type == dtDeltaX, proj2);
+			return minimalGap(proj1, proj2);
+		}
+
+		if (haveCommonPixel(seg1, seg2))
+			return 0.0;
+
+		// without common pixels the closest pair lies on the boundaries: a filled pixel
+		// one step closer to the other segment would exist otherwise
+		int dx1 = seg1.getX() - seg2.getX(), dy1 = seg1.getY() - seg2.getY();
+		int best = INT_MAX;
+		for (size_t u1 = 0; u1 < p1.size(); u1++)
+		{
+			// p1 point in the local coordinates of seg2
+			int x = p1[u1].x + dx1, y = p1[u1].y + dy1;
+
+			size_t lo = 0, hi = p2.size();
+			while (lo < hi)
+			{
+				size_t mid = (lo + hi) / 2;
+				if (p2[mid].x < x)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+
+			for (size_t u2 = lo; u2 < p2.size(); u2++)
+			{
+				int ddx = p2[u2].x - x, ddy = p2[u2].y - y;
+				if (ddx * ddx >= best)
+					break;
+				best = std::min(best, ddx * ddx + ddy * ddy);
+			}
+			for (size_t u2 = lo; u2 > 0; u2--)
+			{
+				int ddx = x - p2[u2 - 1].x, ddy = p2[u2 - 1].y - y;
+				if (ddx * ddx >= best)
+					break;
+				best = std::min(best, ddx * ddx + ddy * ddy);
+			}
+		}
+		return sqrt((double)best);
+	}
+
+	double SegmentTools::getRealDistanceReference(const Segment& seg1, const Segment& seg2, DistanceType type)
 	{
 		Points2i p1 = getAllFilled(seg1);
 		Points2i p2 = getAllFilled(seg2);
@@ -89,16 +229,28 @@ namespace imago
 
 	int SegmentTools::getRealHeight(const Segment& seg)
 	{
-		int min_y = INT_MAX;
-		int max_y = 0;
-		Points2i p = getAllFilled(seg);
-		for (Points2i::iterator it = p.begin(); it != p.end(); ++it)
+		SegmentFeatures& features = seg.getFeatures();
+		if (!features.has(SegmentFeatures::RealHeight))
 		{
-			if (it->y < min_y) min_y = it->y;
-			if (it->y > max_y) max_y = it->y;
+			int min_y = INT_MAX;
+			int max_y = 0;
+			for (int y = 0; y < seg.getHeight(); y++)
+			{
+				for (int x = 0; x < seg.getWidth(); x++)
+				{
+					if (seg.getByte(x,y) == 0)
+					{
+						if (y < min_y) min_y = y;
+						max_y = y;
+						break;
+					}
+				}
+			}
+			int h = max_y - min_y;
+			features.realHeight = h > 0 ? h : 0;
+			features.store(SegmentFeatures::RealHeight);
 		}
-		int h = max_y - min_y;
-		return h > 0 ? h : 0;
+		return features.realHeight;
 	}
 
 	double SegmentTools::getPercentageUnderLine(const Segment& seg, int line_y)
@@ -138,19 +290,49 @@ namespace imago
 
 	Points2i SegmentTools::getEndpoints(const Segment& seg)
 	{
-		Segment thinseg;
-		thinseg.copy(seg);
-		ThinFilter2 tf(thinseg);
-		tf.apply();
-		
-		Points2i endpoints;
+		SegmentFeatures& features = seg.getFeatures();
+		if (!features.has(SegmentFeatures::Endpoints))
+		{
+			const Image& thinseg = getThinned(seg);
 
-		Points2i all = getAllFilled(thinseg);
-		for (Points2i::const_iterator it = all.begin(); it != all.end(); ++it)
-			if (getInRange(thinseg, *it, 1).size() == 1)
-				endpoints.push_back(*it);
+			features.endpoints.clear();
+			for (int y = 0; y < thinseg.getHeight(); y++)
+				for (int x = 0; x < thinseg.getWidth(); x++)
+					if (thinseg.getByte(x,y) == 0 && getInRange(thinseg, Vec2i(x,y), 1).size() == 1)
+						features.endpoints.push_back(Vec2i(x,y));
 
-		return endpoints;
+			features.store(SegmentFeatures::Endpoints);
+		}
+		return features.endpoints;
+	}
+
+	const Image& SegmentTools::getThinned(const Segment& seg)
+	{
+		SegmentFeatures& features = seg.getFeatures();
+		if (!features.has(SegmentFeatures::Thinned))
+		{
+			features.thinned.copy(seg);
+			ThinFilter2(features.thinned).apply();
+			features.store(SegmentFeatures::Thinned);
+		}
+		return features.thinned;
+	}
+
+	const double* SegmentTools::getHuMoments(const Segment& seg)
+	{
+		SegmentFeatures& features = seg.getFeatures();
+		if (!features.has(SegmentFeatures::HuMoments))
+		{
+			int w = seg.getWidth(), h = seg.getHeight();
+			cv::Mat mat(h, w, CV_8U);
+			for (int k = 0; k < h; k++)
+				for (int l = 0; l < w; l++)
+					mat.at<imago::byte> (k, l) = 255 - seg.getByte(l, k);
+			cv::Moments moments = cv::moments(mat, true);
+			cv::HuMoments(moments, features.hu);
+			features.store(SegmentFeatures::HuMoments);
+		}
+		return features.hu;
 	}
 	
 	Vec2i SegmentTools::getNearest(const Vec2i& start, const Points2i& pts)
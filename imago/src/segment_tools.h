@@ -29,10 +29,22 @@ namespace imago
 		// return count of filled points
 		int getFilledCount(const Segment& seg);
 
+		// Segment overloads of getFilledCount, getRealHeight, getEndpoints, getThinned,
+		// getHuMoments and getBoundary are computed once and then served from Segment::getFeatures()
+
 		// returns distance between two sets
 		enum DistanceType { dtEuclidian, dtDeltaX, dtDeltaY };
 		double getRealDistance(const Segment& seg1, const Segment& seg2, DistanceType type = dtEuclidian);
 
+		// the same comparing every pair of filled pixels
+		double getRealDistanceReference(const Segment& seg1, const Segment& seg2, DistanceType type = dtEuclidian);
+
+		// distance between bounding rectangles, never exceeds getRealDistance
+		double getDistanceLowerBound(const Segment& seg1, const Segment& seg2, DistanceType type = dtEuclidian);
+
+		// filled pixels having an empty 4-neighbor or lying on the segment border, ordered by x then y
+		const Points2i& getBoundary(const Segment& seg);
+
 		// returns real segment height (delta between top and bottom filled pixels)
 		int getRealHeight(const Segment& seg);
 
@@ -44,6 +56,12 @@ namespace imago
 		
 		// returns all endpoints
 		Points2i getEndpoints(const Segment& seg);
+
+		// returns thinned copy of segment image
+		const Image& getThinned(const Segment& seg);
+
+		// returns 7 Hu invariant moments of segment pixels
+		const double* getHuMoments(const Segment& seg);
 		
 		// return nearest pixel of pts from start point
 		Vec2i getNearest(const Vec2i& start, const Points2i& pts);
@@ -14,14 +14,134 @@
 
 #include <deque>
 #include <vector>
+#include <algorithm>
+#include <string.h>
 
 #include "comdef.h"
 #include "image.h"
 #include "segmentator.h"
 #include "segment.h"
+#include "rectangle.h"
 
 using namespace imago;
 
+static int findRunRoot(std::vector<int>& parent, int idx)
+{
+   while (parent[idx] != idx)
+   {
+      parent[idx] = parent[parent[idx]]; // path halving
+      idx = parent[idx];
+   }
+   return idx;
+}
+
+static void uniteRuns(std::vector<int>& parent, int a, int b)
+{
+   a = findRunRoot(parent, a);
+   b = findRunRoot(parent, b);
+   // the root is always the first run of segment in raster order
+   if (a < b)
+      parent[b] = a;
+   else if (b < a)
+      parent[a] = b;
+}
+
+void Segmentator::_segmentateRuns( const Image &img, std::vector<Segment*> &segments, int windowSize, byte validColor )
+{
+   int width = img.getWidth(), height = img.getHeight();
+   int half = windowSize >> 1;
+
+   // runs of row y are [row_first[y], row_first[y + 1])
+   std::vector<Run> runs;
+   std::vector<int> row_first(height + 1, 0);
+   for (int y = 0; y < height; y++)
+   {
+      row_first[y] = (int)runs.size();
+      const byte* row = img.ptr(y);
+      for (int x = 0; x < width; x++)
+      {
+         if (row[x] != validColor)
+            continue;
+
+         Run run;
+         run.y = y;
+         run.x1 = x;
+         while (x + 1 < width && row[x + 1] == validColor)
+            x++;
+         run.x2 = x;
+         runs.push_back(run);
+      }
+   }
+   row_first[height] = (int)runs.size();
+
+   std::vector<int> parent(runs.size());
+   for (size_t u = 0; u < runs.size(); u++)
+      parent[u] = (int)u;
+
+   for (int y = 0; y < height; y++)
+   {
+      // runs of the same row are joined if the gap is small enough
+      for (int r = row_first[y]; r + 1 < row_first[y + 1]; r++)
+         if (runs[r + 1].x1 - runs[r].x2 <= half)
+            uniteRuns(parent, r, r + 1);
+
+      // runs of previous rows within window, both lists are ordered by x
+      for (int dy = 1; dy <= half && dy <= y; dy++)
+      {
+         int p = row_first[y - dy], p_end = row_first[y - dy + 1];
+         for (int r = row_first[y]; r < row_first[y + 1]; r++)
+         {
+            while (p < p_end && runs[p].x2 < runs[r].x1 - half)
+               p++;
+            for (int q = p; q < p_end && runs[q].x1 <= runs[r].x2 + half; q++)
+               uniteRuns(parent, r, q);
+         }
+      }
+   }
+
+   // segment ids in raster order of their first runs, bounding boxes
+   std::vector<int> label(runs.size());
+   std::vector<Rectangle> bounds;
+   for (size_t u = 0; u < runs.size(); u++)
+   {
+      const Run& run = runs[u];
+      int root = findRunRoot(parent, (int)u);
+      if (root == (int)u)
+      {
+         label[u] = (int)bounds.size();
+         bounds.push_back(Rectangle(run.x1, run.y, run.x2, run.y, 0));
+      }
+      else
+      {
+         label[u] = label[root];
+         Rectangle& b = bounds[label[u]];
+         b = Rectangle(std::min(b.x1(), run.x1), b.y1(), std::max(b.x2(), run.x2), run.y, 0);
+      }
+   }
+
+   // the reference implementation copies source pixels, white ones are stored as black
+   byte value = (validColor == 255) ? 0 : validColor;
+
+   size_t first = segments.size();
+   for (size_t u = 0; u < bounds.size(); u++)
+   {
+      Segment *segment = new Segment();
+      segment->init(bounds[u].width + 1, bounds[u].height + 1);
+      segment->getX() = bounds[u].x;
+      segment->getY() = bounds[u].y;
+      segment->fillWhite();
+      segments.push_back(segment);
+   }
+
+   for (size_t u = 0; u < runs.size(); u++)
+   {
+      const Run& run = runs[u];
+      Segment *segment = segments[first + label[u]];
+      byte* row = segment->ptr(run.y - segment->getY());
+      memset(row + run.x1 - segment->getX(), value, run.x2 - run.x1 + 1);
+   }
+}
+
 void Segmentator::_walkSegment( const Image &img, BitArray &visited,
                                 Segment *segment, int windowSize, byte validColor )
 {
@@ -33,8 +33,22 @@ namespace imago
 
 	   typedef Basic2dStorage<unsigned char> BitArray;
       
+      // pixels of validColor closer than windowSize/2 in both directions form one segment,
+      // segments are ordered by their first pixel in raster order
       template<typename Container>
       static void segmentate( const Image &img, Container &segments, int windowSize = 3, byte validColor = 0 )
+      {
+         std::vector<Segment*> found;
+         _segmentateRuns(img, found, windowSize, validColor);
+
+         segments.clear();
+         for (size_t u = 0; u < found.size(); u++)
+            segments.push_back(found[u]);
+      }
+
+      // reference flood fill implementation, produces the same segments
+      template<typename Container>
+      static void segmentateReference( const Image &img, Container &segments, int windowSize = 3, byte validColor = 0 )
       {
          int i, j;
 
@@ -62,6 +76,16 @@ namespace imago
       }
 
    private:
+      // horizontal run of validColor pixels, x2 is inclusive
+      struct Run
+      {
+         int y, x1, x2;
+      };
+
+      // splits rows into runs, joins runs closer than windowSize/2 by union-find
+      // and paints every segment directly from its runs
+      static void _segmentateRuns( const Image &img, std::vector<Segment*> &segments, int windowSize, byte validColor );
+
       static void _walkSegment( const Image &img, BitArray &visited,
                                 Segment *segment, int windowSize, byte validColor );
    };
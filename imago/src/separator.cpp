@@ -34,6 +34,9 @@
 #include "image_draw_utils.h"
 #include "separator.h"
 #include "segment.h"
+#include "segment_arena.h"
+#include "segment_index.h"
+#include "segment_tools.h"
 #include "segmentator.h"
 #include "stat_utils.h"
 #include "thin_filter2.h"
@@ -46,30 +49,14 @@
 
 using namespace imago;
 
-Separator::Separator( SegmentDeque &segs, const Image &img ) : _segs(segs), _img(img)
+Separator::Separator( SegmentDeque &segs, const Image &img, SegmentArena &arena ) : _segs(segs), _img(img), _arena(arena)
 {
    std::sort(_segs.begin(), _segs.end(), _segmentsComparator);    
 }
 
-void _getHuMomentsC(const Image &img, double hu[7])
+int Separator::HuClassifier(const Settings& vars, const Segment &seg)
 {
-   int w = img.getWidth(), h = img.getHeight();
-   cv::Mat mat(h, w, CV_8U);
-   for (int k = 0; k < h; k++)
-   {
-      for (int l = 0; l < w; l++)
-      {
-         mat.at<imago::byte> (k, l) = 255 - img.getByte(l, k);
-      }
-   }
-   cv::Moments moments = cv::moments(mat, true);
-   cv::HuMoments(moments, hu);
-}
-
-int Separator::HuClassifier(const Settings& vars, Image &im)
-{
-	double hu[7];
-	_getHuMomentsC(im, hu);
+	const double *hu = SegmentTools::getHuMoments(seg);
 
 	if (hu[1] > vars.separator.hu_1_1 || (hu[1] < vars.separator.hu_1_2 && hu[0] < vars.separator.hu_0_1))
 		return SEP_BOND;
@@ -79,40 +66,20 @@ int Separator::HuClassifier(const Settings& vars, Image &im)
 	return SEP_SUSPICIOUS;
 }
 
-bool Separator::_bIsTextContext(const Settings& vars, SegmentDeque &layer_symbols, imago::Rectangle rec)
+bool Separator::_bIsTextContext(const Settings& vars, const SegmentIndex &symbols_index, imago::Rectangle rec)
 {
-	Segment* firstNear = NULL,
-		*secNear = NULL;
-
-	double dist1 = imago::DIST_INF;
-	double dist2 = imago::DIST_INF;
-
 	Vec2i cntr(rec.x + rec.width/2, rec.y+rec.height/2);
 
-	//find first pair of symbols closer to rec
-	BOOST_FOREACH(Segment *s, layer_symbols)
-	{
-		imago::Rectangle srec = s->getRectangle();
-		Vec2i sc = s->getCenter();
-		
-		double dist = Vec2i::distance(sc, cntr);
+	//find symbol closest to rec
+	std::vector<Segment*> nearest;
+	symbols_index.queryNearest(cntr, 1, nearest);
 
-		if(dist < dist1)
-		{
-			dist1= dist;
-			firstNear = s;
-		}
-
-		if(dist > dist1 && dist< dist2)
-		{
-			dist2 = dist;
-			secNear = s;
-		}
-	}
-
-	if(firstNear == NULL && secNear == NULL)
+	if(nearest.empty())
 		return false;
 
+	Segment* firstNear = nearest[0];
+	double dist1 = Vec2i::distance(firstNear->getCenter(), cntr);
+
 	bool xfirstSeparable = Algebra::rangesSeparable(rec.x, rec.x+rec.width, firstNear->getX(), firstNear->getX() + firstNear->getWidth());
 	bool yfirstSeparable = Algebra::rangesSeparable(rec.y, rec.y+rec.height, firstNear->getY(), firstNear->getY() + firstNear->getHeight());
 	
@@ -466,11 +433,18 @@ void Separator::SeparateStuckedSymbols(const Settings& vars, SegmentDeque &layer
 		
 	double adequate_ratio_min = vars.estimation.MinSymRatio;
 
+	// symbols layer only grows here, the index picks up the appended tail before each query
+	SegmentIndex symbols_index(_img.getWidth(), _img.getHeight(), round(2 * vars.dynamic.CapitalHeight));
+	size_t indexed_symbols = 0;
+
 	for(size_t i=0;i< symbRects.size(); i++)
 	{
 		if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
 
-		bool isTextContext = _bIsTextContext(vars, layer_symbols, symbRects[i]);
+		symbols_index.insert(layer_symbols.begin() + indexed_symbols, layer_symbols.end());
+		indexed_symbols = layer_symbols.size();
+
+		bool isTextContext = _bIsTextContext(vars, symbols_index, symbRects[i]);
 
 		// TODO: check width/height bound
 		if(LineCount[i] < 2 && (!isTextContext || ((double)symbRects[i].width / symbRects[i].height) >= 1/*adequate_ratio_min*/))
@@ -634,6 +608,9 @@ void Separator::SeparateStuckedSymbols(const Settings& vars, SegmentDeque &layer
 							}
 			}
 		}
+
+		// the redundant lines are cleared in place, cached features are outdated
+		s->invalidateFeatures();
 	
 		linesegs.clear();
 
@@ -657,7 +634,7 @@ void Separator::SeparateStuckedSymbols(const Settings& vars, SegmentDeque &layer
 		if(GetClass(cres) == SEP_SYMBOL || isTextContext)
 		{
 			imago::ImageUtils::cutSegment(timg, *s, false, 255);
-			layer_symbols.push_back(s);
+			layer_symbols.push_back(_arena.adopt(s));
 			found_symbol = true;					 
 		}
 		else
@@ -669,6 +646,7 @@ void Separator::SeparateStuckedSymbols(const Settings& vars, SegmentDeque &layer
 		layer_graphics.clear();
 			
 		Segmentator::segmentate(timg, layer_graphics);
+		_arena.adopt(layer_graphics);
 	}
 	
 }
@@ -750,15 +728,10 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 	Segment* s = seg;
 
 	getLogExt().appendSegment("Segment", *s);
-
-	//thin segment
-	Image temp;
-	temp.copy(*s);
-	//s->extractRect(0, 0, s->getWidth(), s->getHeight(), temp); // TODO: check
 	
 	int votes[2] = {0, 0};
 
-	int mark = HuClassifier(vars, temp);
+	int mark = HuClassifier(vars, *s);
 
 	cresults.HuMoments = mark;
 	
@@ -777,45 +750,38 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 		
 	//if(mark == SEP_SUSPICIOUS || mark == SEP_BOND)
 	{
-		ThinFilter2 tfilt(temp);
-		tfilt.apply();
-
-		Segment *thinseg = new Segment();
-		thinseg->copy(*s);
-
 		if (s->getHeight() >= cap_height - sym_height_err && 
 			s->getHeight() <= cap_height + sym_height_err &&
 			s->getHeight() <= cap_height * 2 &&
 			s->getWidth() <= vars.separator.capHeightRatio2 * cap_height) 
 		{
-			if (thinseg->getRatio() > vars.separator.getRatio1 && thinseg->getRatio() < vars.separator.getRatio2)
+			if (s->getRatio() > vars.separator.getRatio1 && s->getRatio() < vars.separator.getRatio2)
 			{
-				if (_analyzeSpecialSegment(vars, thinseg))
+				if (_analyzeSpecialSegment(vars, s))
 				{
 					mark = SEP_BOND;
 				}
 			}
 
-			if (thinseg->getRatio() > adequate_ratio_max)
-				if (ImageUtils::testSlashLine(vars, *thinseg, 0, vars.separator.testSlashLine1))
+			if (s->getRatio() > adequate_ratio_max)
+				if (ImageUtils::testSlashLine(vars, *s, 0, vars.separator.testSlashLine1))
 					mark = SEP_BOND;
 				else
 					mark = SEP_SPECIAL;
 			else
-				if (thinseg->getRatio() < adequate_ratio_min)
-					if (_testDoubleBondV(vars, *thinseg))
+				if (s->getRatio() < adequate_ratio_min)
+					if (_testDoubleBondV(vars, *s))
 						mark = SEP_BOND;
 					else
 						mark = SEP_SUSPICIOUS;
 				else
-					if (ImageUtils::testSlashLine(vars, *thinseg, 0, vars.separator.testSlashLine2))
+					if (ImageUtils::testSlashLine(vars, *s, 0, vars.separator.testSlashLine2))
 						mark = SEP_BOND;
 					else 
 						mark = SEP_SYMBOL;
 		}
 		else
 			mark = SEP_BOND;
-		delete thinseg;
 	}
 
 	if((mark == SEP_SUSPICIOUS || mark == SEP_BOND) && mark < 2)
@@ -913,8 +879,8 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 						if (segs > vars.separator.minApproxSegsWeak)
 						{							
 							getLogExt().appendText("Segments criteria passed");
-							layer_symbols.push_back(s1);
-							layer_symbols.push_back(s2);
+							layer_symbols.push_back(_arena.adopt(s1));
+							layer_symbols.push_back(_arena.adopt(s2));
 							cresults.KNN = SEP_SYMBOL;
 							cresults.Processed = true;
 							//continue;
@@ -1005,6 +971,7 @@ void Separator::Separate(Settings& vars, CharacterRecognizer &rec, SegmentDeque
 
 	pre_classify:
 
+   std::vector<Segment*> pending;
    for (SegmentDeque::iterator it = _segs.begin(); it != _segs.end(); it++)
    {
 	   if (std::find(layer_graphics.begin(), layer_graphics.end(), *it) != layer_graphics.end())
@@ -1013,8 +980,16 @@ void Separator::Separate(Settings& vars, CharacterRecognizer &rec, SegmentDeque
 	   if (std::find(layer_symbols.begin(), layer_symbols.end(), *it) != layer_symbols.end())
 		   continue;
 
-	   Segment *s = *it;
-	   RecognitionDistance rd = rec.recognize(vars, *s, CharacterRecognizer::all + CharacterRecognizer::graphics);
+	   pending.push_back(*it);
+   }
+
+   std::vector<RecognitionDistance> pending_rd;
+   rec.recognizeBatch(vars, pending, pending_rd, CharacterRecognizer::all + CharacterRecognizer::graphics);
+
+   for (size_t u = 0; u < pending.size(); u++)
+   {
+	   Segment *s = pending[u];
+	   const RecognitionDistance& rd = pending_rd[u];
 	   double dist;
 	   char c = rd.getBest(&dist);
 	   if (CharacterRecognizer::graphics.find(c) != std::string::npos && dist < vars.characters.DistanceAbsolutelySure)
@@ -29,12 +29,14 @@ namespace imago
 {
    class Segment;
    class Image;
+   class SegmentArena;
+   class SegmentIndex;
 
    class Separator
    {
    public:      
 
-	Separator( SegmentDeque &segs, const Image &img );
+	Separator( SegmentDeque &segs, const Image &img, SegmentArena &arena );
 
 /// Struct for reporting classification results for a segment
 	  struct ClassifierResults{
@@ -62,6 +64,7 @@ namespace imago
 
       SegmentDeque &_segs;
       const Image &_img;
+      SegmentArena &_arena;
 
       enum
       {
@@ -83,11 +86,11 @@ namespace imago
       
 	  static bool _segmentsComparator( Segment *a, Segment *b );
 	  
-	  bool _bIsTextContext(const Settings& vars, SegmentDeque &layer_symbols, Rectangle rec);
+	  bool _bIsTextContext(const Settings& vars, const SegmentIndex &symbols_index, Rectangle rec);
       
 	  Separator( const Separator &S );
 	  
-	  int HuClassifier(const Settings& vars, Image &im);
+	  int HuClassifier(const Settings& vars, const Segment &seg);
 
 	  int PredictGroup(const Settings& vars, Segment *seg, int mark, SegmentDeque &layer_symbols);
 
@@ -15,6 +15,8 @@
 #include "settings.h"
 #include "platform_tools.h"
 #include "log_ext.h"
+#include "symbol_cache.h"
+#include "filter_statistics.h"
 #include "scanner.h"
 #include <stdio.h>
 #include <string.h> // memset
@@ -37,6 +39,10 @@ namespace imago
 		ClusterIndex = 0; // default
 		StartTime = TimeLimit = 0;
 		ExpandAbbreviations = true;
+		WorkerThreads = 1;
+		SpeculativeFilters = false;
+		AdaptiveFilters = false;
+		CancelRequested = NULL;
 	}
 
 	imago::Settings::Settings()
@@ -129,6 +135,7 @@ namespace imago
 		ASSIGN_REF(characters.ReestimateMinimalCharacters);
 		ASSIGN_REF(characters.MinimalRecognizableHeight);
 		ASSIGN_REF(characters.RatioDiffThresh);
+		ASSIGN_REF(characters.PyramidSurvivors);
 
 		ASSIGN_REF(csr.DeleteBadTriangles);
 		ASSIGN_REF(csr.Dissolve);
@@ -142,6 +149,7 @@ namespace imago
 		ASSIGN_REF(csr.ReconnectProbablyGoodCoef);
 		ASSIGN_REF(csr.StableDecorner);
 		ASSIGN_REF(csr.RescaleImageDimensions);
+		ASSIGN_REF(csr.ReducedDecodeDimensions);
 
 		ASSIGN_REF(estimation.CapitalHeightError);
 		ASSIGN_REF(estimation.CharactersSpaceCoeff);
@@ -470,16 +478,14 @@ namespace imago
 
 	imago::RecognitionCaches::RecognitionCaches()
 	{
-		PCacheSymbolsRecognition = new RecognitionDistanceCacheType();
+		PCacheSymbolsRecognition = &SymbolCache::getShared();
+		PFilterStatistics = &FilterStatistics::getShared();
 	}
 
 	imago::RecognitionCaches::~RecognitionCaches()
 	{
-		if (PCacheSymbolsRecognition)
-		{
-			delete PCacheSymbolsRecognition;
-			PCacheSymbolsRecognition = NULL;
-		}
+		PCacheSymbolsRecognition = NULL;
+		PFilterStatistics = NULL;
 	}
 
 	bool imago::Settings::forceSelectCluster(const std::string& clusterFileName)
@@ -506,6 +512,9 @@ namespace imago
 
 	bool imago::Settings::checkTimeLimit() const
 	{
+		if (general.CancelRequested && *general.CancelRequested)
+			return true;
+
 		if (!general.TimeLimit || !general.StartTime)
 			return false;
 		else
@@ -514,6 +523,9 @@ namespace imago
 
 	bool imago::Settings::checkTimeLimit()
 	{
+		if (general.CancelRequested && *general.CancelRequested)
+			return true;
+
 		if (general.TimeLimit)
 		{
 			if (!general.StartTime)
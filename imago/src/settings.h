@@ -39,6 +39,10 @@ namespace imago
 		bool   UseProbablistics;		
 		bool   ImageAlreadyBinarized;
 		bool   ExpandAbbreviations;
+		int    WorkerThreads; // for batch routines, 0 means as many as hardware supports
+		bool   SpeculativeFilters; // recognize images of all filters concurrently instead of one by one
+		bool   AdaptiveFilters; // order filters by the statistics of the image class (caches.PFilterStatistics)
+		const volatile bool* CancelRequested; // recognition stops at the next time limit check when set, not owned
 		GeneralSettings();
 	};
 
@@ -50,9 +54,13 @@ namespace imago
 		DynamicEstimationSettings();
 	};
 
+	class SymbolCache;
+	class FilterStatistics;
+
 	struct RecognitionCaches // caches for character recognizer, etc
 	{
-		RecognitionDistanceCacheType* PCacheSymbolsRecognition;
+		SymbolCache* PCacheSymbolsRecognition; // shared between sessions, not owned
+		FilterStatistics* PFilterStatistics; // shared between sessions, not owned
 		
 		RecognitionCaches();
 		virtual ~RecognitionCaches();
@@ -249,6 +257,7 @@ namespace imago
 		int    InternalBinarizationThreshold;
 		int    ReestimateMinimalCharacters; 
 		int    MinimalRecognizableHeight; 
+		int    PyramidSurvivors; // templates verified after coarse ranking, 0 disables the coarse level
 		double DistanceScaleFactor; 
 		double RatioDiffThresh; 
 		double PossibleCharacterDistanceStrong;
@@ -264,6 +273,9 @@ namespace imago
 		int    WeakSegmentatorDist;
 		int    SmallImageDim;
 		int    RescaleImageDimensions; 
+		int    ReducedDecodeDimensions; // JPEG is decoded at 1/2..1/8 while the longer side stays not below it, 0 = off;
+		                                // about twice RescaleImageDimensions: A4 at 600 DPI (7016) is halved,
+		                                // at 1200 DPI quartered, pages up to 4800 px (300 DPI) are decoded fully
 		int    ReconnectMinBads; 		
 		double Dissolve;
 		double DeleteBadTriangles;		
@@ -365,7 +377,7 @@ namespace imago
 		// loads configuration from file
 		bool forceSelectCluster(const std::string& clusterFileName);
 
-		// returns true if timelimit occures
+		// returns true if timelimit occures or recognition is cancelled
 		bool checkTimeLimit();
 		bool checkTimeLimit() const;
 
@@ -24,7 +24,7 @@ namespace imago
 	void Atom::addLabel(const char c)
 	{
 		RecognitionDistance dist;
-		dist[c] = 1.0;
+		dist.set(c, 1.0);
 		labels.push_back(CharacterRecognitionEntry(dist));
 	}
 
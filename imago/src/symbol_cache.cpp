@@ -0,0 +1,212 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "symbol_cache.h"
+#include <cstring>
+#include <boost/thread/once.hpp>
+#include "segment.h"
+#include "settings.h"
+#include "font_registry.h"
+
+namespace imago
+{
+	static const qword FNV_OFFSET = 14695981039346656037ULL;
+	static const qword FNV_PRIME = 1099511628211ULL;
+
+	static inline qword hashBytes(qword hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t u = 0; u < size; u++)
+			hash = (hash ^ bytes[u]) * FNV_PRIME;
+		return hash;
+	}
+
+	// final avalanche, so shard selection by low bits is uniform
+	static inline qword mixHash(qword hash)
+	{
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 33;
+		hash *= 0xc4ceb9fe1a85ec53ULL;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	bool SymbolCacheKey::operator <(const SymbolCacheKey& second) const
+	{
+		if (hash != second.hash)
+			return hash < second.hash;
+		if (context != second.context)
+			return context < second.context;
+		if (width != second.width)
+			return width < second.width;
+		return height < second.height;
+	}
+
+	SymbolCache::SymbolCache(size_t capacity, size_t shards)
+	{
+		if (shards == 0)
+			shards = 1;
+
+		for (size_t u = 0; u < shards; u++)
+		{
+			Shard* shard = new Shard();
+			shard->hits = shard->misses = shard->evictions = 0;
+			shard->capacity = 0;
+			_shards.push_back(shard);
+		}
+
+		setCapacity(capacity);
+	}
+
+	SymbolCache::~SymbolCache()
+	{
+		for (size_t u = 0; u < _shards.size(); u++)
+			delete _shards[u];
+		_shards.clear();
+	}
+
+	static SymbolCache* sharedInstance = NULL;
+	static boost::once_flag sharedOnce = BOOST_ONCE_INIT;
+
+	static void createShared()
+	{
+		// never destroyed: sessions may still use it during static destruction
+		sharedInstance = new SymbolCache();
+	}
+
+	SymbolCache& SymbolCache::getShared()
+	{
+		boost::call_once(createShared, sharedOnce);
+		return *sharedInstance;
+	}
+
+	SymbolCacheKey SymbolCache::makeKey(const Settings& vars, const Segment& seg)
+	{
+		SymbolCacheKey key;
+		key.width = seg.getWidth();
+		key.height = seg.getHeight();
+
+		qword hash = FNV_OFFSET;
+		for (int y = 0; y < seg.getHeight(); y++)
+			hash = hashBytes(hash, seg.ptr(y), seg.getWidth());
+		key.hash = mixHash(hash);
+
+		// settings used by CharacterRecognizerImp::recognizeMat and the set of fonts registered
+		qword context = FNV_OFFSET;
+		context = hashBytes(context, &vars.characters.InternalBinarizationThreshold, sizeof(vars.characters.InternalBinarizationThreshold));
+		context = hashBytes(context, &vars.characters.RatioDiffThresh, sizeof(vars.characters.RatioDiffThresh));
+		context = hashBytes(context, &vars.characters.DistanceScaleFactor, sizeof(vars.characters.DistanceScaleFactor));
+		context = hashBytes(context, &vars.characters.PyramidSurvivors, sizeof(vars.characters.PyramidSurvivors));
+		size_t fonts = CharacterRecognizerImp::FontRegistry::getInstance().getFontsCount();
+		context = hashBytes(context, &fonts, sizeof(fonts));
+		key.context = mixHash(context);
+
+		return key;
+	}
+
+	SymbolCache::Shard& SymbolCache::getShard(const SymbolCacheKey& key)
+	{
+		return *_shards[key.hash % _shards.size()];
+	}
+
+	bool SymbolCache::find(const SymbolCacheKey& key, RecognitionDistance& result)
+	{
+		Shard& shard = getShard(key);
+		lock_guard lock(shard.mutex);
+
+		EntryMap::iterator it = shard.lookup.find(key);
+		if (it == shard.lookup.end())
+		{
+			shard.misses++;
+			return false;
+		}
+
+		// move to the front of the recently used list
+		shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+		result = it->second->second;
+		shard.hits++;
+		return true;
+	}
+
+	void SymbolCache::insert(const SymbolCacheKey& key, const RecognitionDistance& value)
+	{
+		Shard& shard = getShard(key);
+		lock_guard lock(shard.mutex);
+
+		EntryMap::iterator it = shard.lookup.find(key);
+		if (it != shard.lookup.end())
+		{
+			it->second->second = value;
+			shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+			return;
+		}
+
+		if (shard.capacity == 0)
+			return;
+
+		shard.entries.push_front(Entry(key, value));
+		shard.lookup[key] = shard.entries.begin();
+		evict(shard);
+	}
+
+	void SymbolCache::evict(Shard& shard)
+	{
+		while (shard.lookup.size() > shard.capacity)
+		{
+			shard.lookup.erase(shard.entries.back().first);
+			shard.entries.pop_back();
+			shard.evictions++;
+		}
+	}
+
+	void SymbolCache::clear()
+	{
+		for (size_t u = 0; u < _shards.size(); u++)
+		{
+			lock_guard lock(_shards[u]->mutex);
+			_shards[u]->lookup.clear();
+			_shards[u]->entries.clear();
+		}
+	}
+
+	void SymbolCache::setCapacity(size_t capacity)
+	{
+		size_t per_shard = (capacity + _shards.size() - 1) / _shards.size();
+		for (size_t u = 0; u < _shards.size(); u++)
+		{
+			lock_guard lock(_shards[u]->mutex);
+			_shards[u]->capacity = per_shard;
+			evict(*_shards[u]);
+		}
+	}
+
+	SymbolCacheStatistics SymbolCache::getStatistics() const
+	{
+		SymbolCacheStatistics result;
+		memset(&result, 0, sizeof(result));
+
+		for (size_t u = 0; u < _shards.size(); u++)
+		{
+			lock_guard lock(_shards[u]->mutex);
+			result.hits += _shards[u]->hits;
+			result.misses += _shards[u]->misses;
+			result.evictions += _shards[u]->evictions;
+			result.size += _shards[u]->lookup.size();
+			result.capacity += _shards[u]->capacity;
+		}
+
+		return result;
+	}
+}
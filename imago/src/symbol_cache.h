@@ -0,0 +1,107 @@
+/****************************************************************************
+ * Copyright (C) 2009-2013 GGA Software Services LLC
+ *
+ * This file is part of Imago OCR project.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _symbol_cache_h
+#define _symbol_cache_h
+
+#include <list>
+#include <map>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#include "comdef.h"
+#include "recognition_distance.h"
+
+namespace imago
+{
+	class Segment;
+	struct Settings;
+
+	struct SymbolCacheKey
+	{
+		qword hash;    // 64-bit hash of the segment pixels
+		qword context; // hash of the settings and fonts affecting the recognition result
+		int width;
+		int height;
+
+		bool operator <(const SymbolCacheKey& second) const;
+	};
+
+	struct SymbolCacheStatistics
+	{
+		qword hits;
+		qword misses;
+		qword evictions;
+		size_t size;
+		size_t capacity;
+	};
+
+	// bounded LRU cache of symbol recognition results, sharded by hash and safe for concurrent sessions
+	class SymbolCache
+	{
+	public:
+		static const size_t DEFAULT_CAPACITY = 65536;
+		static const size_t DEFAULT_SHARDS = 16;
+
+		SymbolCache(size_t capacity = DEFAULT_CAPACITY, size_t shards = DEFAULT_SHARDS);
+		~SymbolCache();
+
+		// process-wide instance used by Settings by default
+		static SymbolCache& getShared();
+
+		static SymbolCacheKey makeKey(const Settings& vars, const Segment& seg);
+
+		// returns true and fills result if the key is present
+		bool find(const SymbolCacheKey& key, RecognitionDistance& result);
+
+		// stores value, evicts the least recently used entries of the shard if it is full
+		void insert(const SymbolCacheKey& key, const RecognitionDistance& value);
+
+		// removes entries, keeps counters
+		void clear();
+
+		// total capacity, existing entries over the limit are evicted
+		void setCapacity(size_t capacity);
+
+		SymbolCacheStatistics getStatistics() const;
+
+	private:
+		SymbolCache(const SymbolCache&);
+		SymbolCache& operator=(const SymbolCache&);
+
+		typedef std::pair<SymbolCacheKey, RecognitionDistance> Entry;
+		typedef std::list<Entry> EntryList;
+		typedef std::map<SymbolCacheKey, EntryList::iterator> EntryMap;
+		typedef boost::lock_guard<boost::mutex> lock_guard;
+
+		struct Shard
+		{
+			boost::mutex mutex;
+			EntryList entries; // most recently used first
+			EntryMap lookup;
+			size_t capacity;
+			qword hits;
+			qword misses;
+			qword evictions;
+		};
+
+		Shard& getShard(const SymbolCacheKey& key);
+		static void evict(Shard& shard);
+
+		std::vector<Shard*> _shards;
+	};
+}
+
+#endif // _symbol_cache_h
@@ -13,12 +13,12 @@
  ***************************************************************************/
 
 #include "weak_segmentator.h"
-#include <queue>
 #include <string.h>
+#include <algorithm>
+#include <limits>
 #include "log_ext.h"
 #include "pixel_boundings.h"
 #include "thin_filter2.h"
-#include "segment_tools.h"
 
 namespace imago
 {	
@@ -50,40 +50,208 @@ namespace imago
 	{
 		logEnterFunction();
 
-		for (int y = 0; y < img.getHeight(); y++)
+		const int w = img.getWidth(), h = img.getHeight();
+		for (int y = 0; y < h; y++)
 		{
-			for (int x = 0; x < img.getWidth(); x++)
+			// neighbors are read in place, so the pixels already processed are seen updated
+			byte* row = img.ptr(y);
+			const byte* above = (y > 0) ? img.ptr(y - 1) : NULL;
+			const byte* below = (y + 1 < h) ? img.ptr(y + 1) : NULL;
+			for (int x = 0; x < w; x++)
 			{
-				if (!img.isFilled(x,y))
+				if (row[x] == 255)
 					continue;
 
-				if (SegmentTools::getInRange(img, Vec2i(x,y), 1).size() > 2)
-					img.getByte(x,y) = set_to;
+				int neighbors = 0;
+				for (int tx = std::max(x - 1, 0); tx <= std::min(x + 1, w - 1); tx++)
+				{
+					if (above && above[tx] == 0)
+						neighbors++;
+					if (below && below[tx] == 0)
+						neighbors++;
+					if (tx != x && row[tx] == 0)
+						neighbors++;
+				}
+
+				if (neighbors > 2)
+					row[x] = set_to;
 			}
 		}
 
 		getLogExt().appendImage("Decorner", img);
 	}
 
+	int WeakSegmentator::findRoot(std::vector<int>& parent, int idx)
+	{
+		while (parent[idx] != idx)
+		{
+			parent[idx] = parent[parent[idx]]; // path halving
+			idx = parent[idx];
+		}
+		return idx;
+	}
+
+	void WeakSegmentator::unite(std::vector<int>& parent, int a, int b)
+	{
+		a = findRoot(parent, a);
+		b = findRoot(parent, b);
+		if (a < b)
+			parent[b] = a;
+		else if (b < a)
+			parent[a] = b;
+	}
+
+	template <typename Label>
+	bool WeakSegmentator::labelPixels(const Image& img, const Points2i& lookup_pattern, bool reconnect,
+	                                  std::vector<Label>& labels, int& added, int& count) const
+	{
+		const int w = width(), h = height();
+		const int max_label = std::numeric_limits<Label>::max();
+
+		// every pattern connection is checked from its later pixel in raster order,
+		// long offsets of connect mode put their middle points into segments
+		Points2i causal, jumps;
+		for (size_t v = 0; v < lookup_pattern.size(); v++)
+		{
+			Vec2i o = lookup_pattern[v];
+			if (o.y > 0 || (o.y == 0 && o.x > 0))
+				causal.push_back(Vec2i(-o.x, -o.y));
+			else
+				causal.push_back(o);
+			if (reconnect && (abs(o.x) > 1 || abs(o.y) > 1))
+				jumps.push_back(o);
+		}
+
+		// provisional labels are written to the map in one raster pass, equivalences
+		// between them are kept in a union-find whose roots are the smallest labels
+		labels.assign(w * h, 0);
+		std::vector<int> parent(1, 0);
+		added = 0;
+
+		for (int y = 0; y < h; y++)
+			for (int x = 0; x < w; x++)
+			{
+				const int idx = y * w + x;
+				const bool old = getLabel(x, y) != 0;
+				const bool filled = !old && img.getByte(x, y) != 255;
+				bool node = old || filled;
+				int label = 0;
+
+				// pixel is the middle point of a long offset between two new pixels
+				for (size_t v = 0; v < jumps.size(); v++)
+				{
+					int px = x - jumps[v].x / 2, py = y - jumps[v].y / 2;
+					if (!isNewPixel(img, px, py) || !isNewPixel(img, px + jumps[v].x, py + jumps[v].y))
+						continue;
+					node = true;
+					if (py * w + px < idx)
+						joinLabel(parent, label, labels[py * w + px]);
+				}
+
+				if (!node)
+					continue;
+
+				for (size_t v = 0; v < causal.size(); v++)
+				{
+					int tx = x + causal[v].x, ty = y + causal[v].y;
+					if (inRange(tx, ty) && labels[ty * w + tx] != 0)
+						joinLabel(parent, label, labels[ty * w + tx]);
+				}
+
+				// new pixel joins the middle points of its long offsets passed already
+				for (size_t v = 0; filled && v < jumps.size(); v++)
+				{
+					int mx = x + jumps[v].x / 2, my = y + jumps[v].y / 2;
+					if (my * w + mx < idx && isNewPixel(img, x + jumps[v].x, y + jumps[v].y))
+						joinLabel(parent, label, labels[my * w + mx]);
+				}
+
+				if (label == 0)
+				{
+					if ((int)parent.size() > max_label)
+						return false;
+					label = (int)parent.size();
+					parent.push_back(label);
+				}
+
+				labels[idx] = (Label)label;
+				if (!old)
+					added++;
+			}
+
+		// roots are met at the first pixels of segments, so final ids go in raster order
+		// and never exceed the provisional ones
+		std::vector<int> ids(parent.size(), 0);
+		count = 0;
+		for (int idx = 0; idx < w * h; idx++)
+		{
+			if (labels[idx] == 0)
+				continue;
+
+			int root = findRoot(parent, labels[idx]);
+			if (ids[root] == 0)
+				ids[root] = ++count;
+			labels[idx] = (Label)ids[root];
+		}
+
+		return true;
+	}
+
 	int WeakSegmentator::appendData(const Image& img, const Points2i& lookup_pattern, bool reconnect)
 	{
 		logEnterFunction();
 			
-		int added_pixels = 0;
+		const int w = width(), h = height();
 
-		for (int y = 0; y < height(); y++)
-			for (int x = 0; x < width(); x++)
-				if (at(x,y) == 0 && (img.getByte(x,y) != 255))
-				{
-					int id = SegmentPoints.size()+1;
-					fill(img, id, x, y, lookup_pattern, reconnect);			
-					added_pixels += SegmentPoints[id].size();
-				}
+		// pixels of already added segments and new filled pixels take part in labeling;
+		// the labels map itself holds the provisional labels, 32-bit only if 16 bits overflow
+		std::vector<unsigned short> labels16;
+		std::vector<int> labels32;
+		int added = 0, count = 0;
+		if (!labelPixels(img, lookup_pattern, reconnect, labels16, added, count))
+		{
+			std::vector<unsigned short>().swap(labels16);
+			labelPixels(img, lookup_pattern, reconnect, labels32, added, count);
+		}
+		_labels16.swap(labels16);
+		_labels32.swap(labels32);
 
-		getLogExt().append("Currently added pixels", added_pixels);
-		getLogExt().append("Total segments count", SegmentPoints.size());
+		std::vector<int> sizes(count + 1, 0);
+		for (int idx = 0; idx < w * h; idx++)
+			sizes[getLabel(idx % w, idx / w)]++;
+
+		_offsets.assign(count + 1, 0);
+		for (int id = 1; id <= count; id++)
+			_offsets[id] = _offsets[id - 1] + sizes[id];
+
+		_points.resize(_offsets[count]);
+		std::vector<int> filled(_offsets.begin(), _offsets.end() - 1);
+		for (int y = 0; y < h; y++)
+			for (int x = 0; x < w; x++)
+			{
+				int label = getLabel(x,y);
+				if (label != 0)
+					_points[filled[label - 1]++] = Vec2i(x, y);
+			}
 
-		return added_pixels;
+		getLogExt().append("Currently added pixels", added);
+		getLogExt().append("Total segments count", count);
+
+		return added;
+	}
+
+	size_t WeakSegmentator::getMemoryUsage() const
+	{
+		return _labels16.size() * sizeof(unsigned short) + _labels32.size() * sizeof(int) +
+		       _points.size() * sizeof(Vec2i) + _offsets.size() * sizeof(int);
+	}
+
+	WeakSegmentator::PointsRange WeakSegmentator::getSegmentPoints(int id) const
+	{
+		PointsRange result;
+		result.first = _points.empty() ? NULL : &_points[0] + _offsets[id - 1];
+		result.last = result.first + (_offsets[id] - _offsets[id - 1]);
+		return result;
 	}
 
 	bool WeakSegmentator::needCrop(const Settings& vars, Rectangle& crop, int winSize)
@@ -91,7 +259,7 @@ namespace imago
 		logEnterFunction();
 
 		int area_pixels = round(width() * height() * vars.weak_seg.RectangularCropAreaTreshold);
-		for (size_t id = 1; id <= SegmentPoints.size(); id++)
+		for (int id = 1; id <= getSegmentsCount(); id++)
 		{			
 			Rectangle bounds;
 			if (getRectangularArea(id) > area_pixels && hasRectangularStructure(vars, id, bounds, winSize))
@@ -107,18 +275,19 @@ namespace imago
 
 	int WeakSegmentator::getRectangularArea(int id)
 	{
-		RectShapedBounding b(SegmentPoints[id]);		
+		PointsRange p = getSegmentPoints(id);
+		RectShapedBounding b(p.first, p.last);
 		return b.getBounding().width * b.getBounding().height;
 	}		
 
 	bool WeakSegmentator::hasRectangularStructure(const Settings& vars, int id, Rectangle& bound, int winSize)
 	{
-		Points2i& p = SegmentPoints[id];
+		PointsRange p = getSegmentPoints(id);
 		
 		std::vector<int> map_x;
 		std::vector<int> map_y;
 
-		for (Points2i::iterator it = p.begin(); it != p.end(); ++it)
+		for (const Vec2i* it = p.first; it != p.last; ++it)
 		{
 			if (it->x >= (int)map_x.size())
 				map_x.resize(it->x + 1);
@@ -136,7 +305,7 @@ namespace imago
 			map_x.clear();
 			map_y.clear();
 
-			for (Points2i::iterator it = p.begin(); it != p.end(); ++it)
+			for (const Vec2i* it = p.first; it != p.last; ++it)
 			{
 				if (it->y > y1c && it->y < y2c)
 				{
@@ -156,7 +325,7 @@ namespace imago
 				fabs(x1c - x2c) > 2*winSize && fabs(y1c - y2c) > 2*winSize)
 			{
 				int good = 0, bad = 0;
-				for (Points2i::iterator it = p.begin(); it != p.end(); ++it)
+				for (const Vec2i* it = p.first; it != p.last; ++it)
 					if ((fabs(it->x - x1c) < winSize || fabs(it->x - x2c) < winSize) ||
 						(fabs(it->y - y1c) < winSize || fabs(it->y - y2c) < winSize))
 						good++;
@@ -173,56 +342,6 @@ namespace imago
 		return false;
 	}
 
-	void WeakSegmentator::fill(const Image& img, int& id, int sx, int sy, const Points2i& lookup_pattern, bool reconnect)
-	{
-		std::queue<Vec2i> v;
-		v.push(Vec2i(sx,sy));
-		while (!v.empty())
-		{
-			Vec2i cur = v.front();
-			v.pop(); // remove top
-
-			if (at(cur.x,cur.y) == 0)
-			{
-				at(cur.x,cur.y) = id;
-				SegmentPoints[id].push_back(cur);
-
-				for (size_t w = 0; w < lookup_pattern.size(); w++)
-				{
-					int dx = lookup_pattern[w].x;
-					int dy = lookup_pattern[w].y;
-					Vec2i t(cur.x + dx,cur.y + dy);
-					if (inRange(t.x, t.y))
-					{
-						if (at(t.x, t.y) == 0)
-						{					
-							if (img.isFilled(t.x, t.y))
-							{
-								if (reconnect && (abs(dx) > 1 || abs(dy) > 1) )
-								{
-									v.push(Vec2i(cur.x + dx/2,cur.y + dy/2));
-								}
-								v.push(t);
-							}
-						}
-						else if (at(t.x, t.y) != id)
-						{
-							int merge_id = at(t.x, t.y);
-							for (size_t u = 0; u < SegmentPoints[id].size(); u++)
-							{
-								Vec2i p = SegmentPoints[id][u];
-								at(p.x, p.y) = merge_id;
-								SegmentPoints[merge_id].push_back(p);
-							}
-							SegmentPoints.erase(SegmentPoints.find(id));
-							id = merge_id;
-						} // if
-					} // inRange
-				} // for
-			} // if
-		} // while
-	}
-
 	bool WeakSegmentator::get2centers(const std::vector<int>& data, double &c1, double& c2) // c1 < c2
 	{
 		double mean = 0.0, count = 0.0;
@@ -16,24 +16,45 @@
 #ifndef _weak_segmentator_h
 #define _weak_segmentator_h
 
-#include <map>
 #include <vector>
 #include "image.h"
-#include "basic_2d_storage.h"
 #include "rectangle.h"
 #include "stl_fwd.h"
 #include "settings.h"
 
 namespace imago
 {
-	class WeakSegmentator : public Basic2dStorage<int /*id*/>
+	class WeakSegmentator
 	{
 	public:		
 		static Points2i getLookupPattern(int range = 1, bool fill = true);
 
-		WeakSegmentator(int width, int height) : Basic2dStorage<int>(width, height) {}		
+		WeakSegmentator(int width, int height) : _w(width), _h(height), _offsets(1, 0) {}		
 
-		// addend data from image (img.isFilled() called)
+		int width() const { return _w; }
+		int height() const { return _h; }
+
+		bool inRange(int x, int y) const
+		{
+			return x >= 0 && y >= 0 && x < _w && y < _h;
+		}
+
+		// segment id of pixel, 0 for background
+		int getLabel(int x, int y) const
+		{
+			if (!_labels16.empty())
+				return _labels16[y * _w + x];
+			if (!_labels32.empty())
+				return _labels32[y * _w + x];
+			return 0;
+		}
+
+		// bytes used by the labels and the points of segments
+		size_t getMemoryUsage() const;
+
+		// addend data from image (img.isFilled() called), pixels connected by lookup_pattern offsets
+		// form one segment; in connectMode middle points of long offsets are added to segments too.
+		// segment ids are renumbered in raster order of their first pixels, returns added pixels count
 		int appendData(const Image &img, const Points2i& lookup_pattern = getLookupPattern(), bool connectMode = false);
 		
 		// updates crop if required
@@ -42,8 +63,19 @@ namespace imago
 		// decorner image by setting corner pixels to 'set_to' value
 		static void decorner(Image &img, byte set_to);
 
-		typedef std::map<int, Points2i> SegMap;
-		SegMap SegmentPoints;		
+		// points of one segment, stored contiguously in raster order
+		struct PointsRange
+		{
+			const Vec2i* first;
+			const Vec2i* last;
+
+			size_t size() const { return last - first; }
+			const Vec2i& operator[](size_t index) const { return first[index]; }
+		};
+
+		// segment ids are 1..getSegmentsCount()
+		int getSegmentsCount() const { return (int)_offsets.size() - 1; }
+		PointsRange getSegmentPoints(int id) const;
 
 	protected:				
 		// returns area of bounding box of segment with id
@@ -53,11 +85,38 @@ namespace imago
 		bool hasRectangularStructure(const Settings& vars, int id, Rectangle& bound, int winSize);
 		
 	private:
-		// returns filled pixels count
-		void fill(const Image& img, int& id, int startx, int starty, const Points2i& lookup_pattern, bool connectMode);
+		// union-find over provisional labels, the root is always the smallest label of the set
+		static int findRoot(std::vector<int>& parent, int idx);
+		static void unite(std::vector<int>& parent, int a, int b);
 
 		// returns 2 probably condensation point for integer vector
 		static bool get2centers(const std::vector<int>& data, double &c1, double& c2);		
+
+		// new filled pixel, not belonging to already added segments
+		bool isNewPixel(const Image& img, int x, int y) const
+		{
+			return inRange(x, y) && getLabel(x, y) == 0 && img.getByte(x, y) != 255;
+		}
+
+		// label belongs to the set of the pixel labeled first or is united with it
+		static void joinLabel(std::vector<int>& parent, int& label, int other)
+		{
+			if (label == 0)
+				label = other;
+			else
+				unite(parent, label, other);
+		}
+
+		// labels pixels into map of the given width, fails when provisional labels do not fit it
+		template <typename Label>
+		bool labelPixels(const Image& img, const Points2i& lookup_pattern, bool reconnect,
+		                 std::vector<Label>& labels, int& added, int& count) const;
+
+		int _w, _h;
+		std::vector<unsigned short> _labels16; // labels map while ids fit 16 bits
+		std::vector<int> _labels32;            // labels map otherwise
+		Points2i _points;          // points of all segments ordered by id
+		std::vector<int> _offsets; // points of segment id are [_offsets[id-1], _offsets[id])
 	};
 }
 
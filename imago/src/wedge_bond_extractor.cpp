@@ -298,11 +298,9 @@ int WedgeBondExtractor::singleDownFetch(const Settings& vars, Skeleton &g )
    {
       std::vector<Segment *>::iterator res = std::find(to_delete_segs.begin(), to_delete_segs.end(), *it);
 
+      // segments are owned by the recognition arena
       if (res != to_delete_segs.end())
-      {
-         delete *it;
          it = _segs.erase(it);
-      }
       else
          ++it;
    }